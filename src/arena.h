@@ -1,45 +1,107 @@
 #pragma once
+#include <stdalign.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define ARENA_BLOCK_SIZE (16 * 1024)
+// Allocation sizes are rounded up to this, so that every allocation starts
+// aligned for any float / SIMD / uint64 array after odd-sized byte buffers
+#define ARENA_ALIGN 16
 
+// Blocks are chained in allocation order. Every block after `current` is
+// free (used == 0), which is what lets reset/rewind hand them out again.
 typedef struct ArenaBlock {
   struct ArenaBlock *next;
+  size_t capacity;
   size_t used;
-  unsigned char data[ARENA_BLOCK_SIZE];
+  alignas(max_align_t) unsigned char data[];
 } ArenaBlock;
 
+#ifdef ARENA_TRACE
+#ifndef ARENA_STATS
+#define ARENA_STATS
+#endif
+// Called for every allocation with the call site that requested it
+typedef void (*ArenaTraceFn)(void *user, const char *file, int line, size_t size);
+#endif
+
 typedef struct {
   ArenaBlock *head;
+  ArenaBlock *current;
+#ifdef ARENA_STATS
+  size_t live;   // bytes currently handed out
+  size_t peak;   // high-water mark of live
+  size_t allocs; // allocation calls since creation
+#endif
+#ifdef ARENA_TRACE
+  ArenaTraceFn trace;
+  void *trace_user;
+#endif
 } Arena;
 
+typedef struct {
+  size_t requested; // bytes currently handed out
+  size_t peak;      // high-water mark of requested (needs ARENA_STATS)
+  size_t allocs;    // allocation calls (needs ARENA_STATS)
+  size_t reserved;  // bytes held in blocks, excluding headers
+  size_t wasted;    // unusable tail bytes in blocks before the current one
+  size_t blocks;
+} ArenaStats;
+
+// Saved arena position, see arena_mark / arena_rewind
+typedef struct {
+  ArenaBlock *block;
+  size_t used;
+} ArenaMark;
+
 static inline Arena *arena_create(void) {
   Arena *a = (Arena *)calloc(1, sizeof(Arena));
   return a;
 }
 
 static inline void *arena_alloc(Arena *a, size_t size) {
-  // Handle large allocations that exceed block size
-  if (size > ARENA_BLOCK_SIZE) {
-    size_t block_size = offsetof(ArenaBlock, data) + size;
-    ArenaBlock *b = (ArenaBlock *)calloc(1, block_size);
-    b->used = size;
-    b->next = a->head;
-    a->head = b;
-    return b->data;
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+#ifdef ARENA_STATS
+  a->allocs++;
+  a->live += size;
+  if (a->live > a->peak)
+    a->peak = a->live;
+#endif
+
+  ArenaBlock *b = a->current;
+  if (b && b->used + size <= b->capacity) {
+    void *ptr = b->data + b->used;
+    b->used += size;
+    return ptr;
   }
 
-  if (!a->head || a->head->used + size > ARENA_BLOCK_SIZE) {
-    ArenaBlock *b = (ArenaBlock *)calloc(1, sizeof(ArenaBlock));
-    b->next = a->head;
-    a->head = b;
+  // Reuse a free block further down the chain (left behind by a reset/rewind)
+  for (ArenaBlock *n = b ? b->next : a->head; n; n = n->next) {
+    if (size <= n->capacity) {
+      a->current = n;
+      n->used = size;
+      return n->data;
+    }
   }
 
-  void *ptr = a->head->data + a->head->used;
-  a->head->used += size;
-  return ptr;
+  // Handle large allocations that exceed block size
+  size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+  ArenaBlock *nb = (ArenaBlock *)calloc(1, offsetof(ArenaBlock, data) + capacity);
+  nb->capacity = capacity;
+  nb->used = size;
+
+  // Insert right after the current block so the free tail stays reusable
+  if (b) {
+    nb->next = b->next;
+    b->next = nb;
+  } else {
+    nb->next = a->head;
+    a->head = nb;
+  }
+  a->current = nb;
+  return nb->data;
 }
 
 static inline void *arena_alloc_zero(Arena *a, size_t size) {
@@ -48,11 +110,96 @@ static inline void *arena_alloc_zero(Arena *a, size_t size) {
   return p;
 }
 
+// Remember the current position for scoped temporary allocations
+static inline ArenaMark arena_mark(const Arena *a) {
+  return (ArenaMark){.block = a->current, .used = a->current ? a->current->used : 0};
+}
+
+// Release everything allocated since the mark, keeping the blocks for reuse
+static inline void arena_rewind(Arena *a, ArenaMark m) {
+  ArenaBlock *b = m.block ? m.block->next : a->head;
+  for (; b; b = b->next) {
+#ifdef ARENA_STATS
+    a->live -= b->used;
+#endif
+    b->used = 0;
+  }
+
+  if (m.block) {
+#ifdef ARENA_STATS
+    a->live -= m.block->used - m.used;
+#endif
+    m.block->used = m.used;
+  }
+  a->current = m.block;
+}
+
 static inline void arena_reset(Arena *a) {
   for (ArenaBlock *b = a->head; b; b = b->next)
     b->used = 0;
+  a->current = a->head;
+#ifdef ARENA_STATS
+  a->live = 0;
+#endif
 }
 
+// Walk the block chain and report memory consumption. For the size of a
+// configuration before building it, see ArenaBudget.
+static inline ArenaStats arena_stats(const Arena *a) {
+  ArenaStats s = {0};
+  bool before_current = a->current != NULL;
+  for (const ArenaBlock *b = a->head; b; b = b->next) {
+    s.blocks++;
+    s.reserved += b->capacity;
+    s.requested += b->used;
+    if (b == a->current)
+      before_current = false;
+    else if (before_current)
+      s.wasted += b->capacity - b->used;
+  }
+#ifdef ARENA_STATS
+  s.peak = a->peak;
+  s.allocs = a->allocs;
+#endif
+  return s;
+}
+
+// Upper bound on what a sequence of allocations reserves, added up before
+// making them. Every allocation opens at most one block, of at most
+// max(size, ARENA_BLOCK_SIZE) plus its header, so that is what it is charged;
+// scratch that is rewound later is charged as if kept.
+typedef struct {
+  size_t bytes;
+} ArenaBudget;
+
+static inline void arena_budget(ArenaBudget *b, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  b->bytes += offsetof(ArenaBlock, data) + (size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+}
+
+#ifdef ARENA_TRACE
+static inline void arena_set_trace(Arena *a, ArenaTraceFn fn, void *user) {
+  a->trace = fn;
+  a->trace_user = user;
+}
+
+static inline void *arena_alloc_traced(Arena *a, size_t size, const char *file, int line) {
+  if (a->trace)
+    a->trace(a->trace_user, file, line, size);
+  return arena_alloc(a, size);
+}
+
+static inline void *arena_alloc_zero_traced(Arena *a, size_t size, const char *file, int line) {
+  void *p = arena_alloc_traced(a, size, file, line);
+  memset(p, 0, size);
+  return p;
+}
+
+// Route every later call through the tracer so it sees the caller's location
+#define arena_alloc(a, size) arena_alloc_traced((a), (size), __FILE__, __LINE__)
+#define arena_alloc_zero(a, size) arena_alloc_zero_traced((a), (size), __FILE__, __LINE__)
+#endif
+
 static inline void arena_destroy(Arena *a) {
   ArenaBlock *b = a->head;
   while (b) {
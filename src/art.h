@@ -1,10 +1,43 @@
 #pragma once
 
 #include "arena.h"
+#include "numerics.h"
+#include "parallel.h"
 #include "ray.h"
 #include "utils.h"
 #include <math.h>
 
+// Storage order of the grid cells.
+// Row-major strides by nx floats per step along near-vertical rays. The
+// blocked layout stores 8x8 cell blocks contiguously (block rows, then
+// row-major inside a block), so a ray at any angle stays within a few cache
+// lines per block. The grid is padded to whole blocks; padding cells are never
+// hit by a ray and stay zero.
+typedef enum {
+  GRID_LAYOUT_ROW_MAJOR = 0,
+  GRID_LAYOUT_BLOCKED = 1,
+} GridLayout;
+
+#define GRID_BLOCK 8
+
+// Half-open rectangle of cells [x0, x1) x [y0, y1), empty when x0 >= x1
+typedef struct {
+  int x0, y0, x1, y1;
+} ReconRect;
+
+#define RECON_RECT_EMPTY ((ReconRect){0, 0, 0, 0})
+
+static inline bool recon_rect_empty(ReconRect r) { return r.x0 >= r.x1 || r.y0 >= r.y1; }
+
+static inline ReconRect recon_rect_union(ReconRect a, ReconRect b) {
+  if (recon_rect_empty(a))
+    return b;
+  if (recon_rect_empty(b))
+    return a;
+  return (ReconRect){a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+                     a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1};
+}
+
 // Reconstruction grid
 typedef struct {
   float *values;       // Current reconstruction values
@@ -12,46 +45,169 @@ typedef struct {
   float *row_buffer;   // Scratch buffer for system matrix row
   int nx, ny;          // Grid dimensions
   int cell_size;       // Pixels per cell
-  int n;               // Total cells (nx * ny)
+  int n;               // Stored cells (nx * ny, plus block padding)
+  GridLayout layout;
+  int blocks_x;        // Blocks per block row (GRID_LAYOUT_BLOCKED)
+  ReconRect dirty;     // Cells changed since the display last took it
 } ReconGrid;
 
-// Allocate reconstruction grid
-static inline ReconGrid recon_grid_alloc(Arena *arena, int img_w, int img_h, int cell_size) {
-  ReconGrid g;
+// Record changed cells for the display refresh
+static inline void recon_grid_touch(ReconGrid *g, ReconRect r) { g->dirty = recon_rect_union(g->dirty, r); }
+
+static inline void recon_grid_touch_all(ReconGrid *g) { g->dirty = (ReconRect){0, 0, g->nx, g->ny}; }
+
+// Changed cells since the last call
+static inline ReconRect recon_grid_take_dirty(ReconGrid *g) {
+  ReconRect r = g->dirty;
+  g->dirty = RECON_RECT_EMPTY;
+  return r;
+}
+
+// Storage index of cell (ix, iy)
+static inline int recon_grid_index(const ReconGrid *g, int ix, int iy) {
+  if (g->layout == GRID_LAYOUT_BLOCKED)
+    return ((iy / GRID_BLOCK) * g->blocks_x + ix / GRID_BLOCK) * (GRID_BLOCK * GRID_BLOCK) + (iy % GRID_BLOCK) * GRID_BLOCK +
+           ix % GRID_BLOCK;
+  return iy * g->nx + ix;
+}
+
+// Cells from (ix, iy) onward in the same grid row that are contiguous in
+// storage, up to x_end
+static inline int recon_grid_run(const ReconGrid *g, int ix, int x_end) {
+  int run = x_end - ix;
+  if (g->layout == GRID_LAYOUT_BLOCKED && run > GRID_BLOCK - ix % GRID_BLOCK)
+    run = GRID_BLOCK - ix % GRID_BLOCK;
+  return run;
+}
+
+// Cell coordinates of a storage index
+static inline void recon_grid_coords(const ReconGrid *g, int index, int *ix, int *iy) {
+  if (g->layout == GRID_LAYOUT_BLOCKED) {
+    int block = index / (GRID_BLOCK * GRID_BLOCK);
+    int inner = index % (GRID_BLOCK * GRID_BLOCK);
+    *ix = (block % g->blocks_x) * GRID_BLOCK + inner % GRID_BLOCK;
+    *iy = (block / g->blocks_x) * GRID_BLOCK + inner / GRID_BLOCK;
+    return;
+  }
+  *ix = index % g->nx;
+  *iy = index / g->nx;
+}
+
+// Value range enforced by the constrained solvers
+typedef struct {
+  float lo, hi;
+} ReconBounds;
+
+#define RECON_UNBOUNDED ((ReconBounds){-INFINITY, INFINITY})
+
+// Plain compares rather than fminf/fmaxf, which are not always inlined
+static inline float recon_clamp(float v, ReconBounds b) {
+  v = v < b.lo ? b.lo : v;
+  return v > b.hi ? b.hi : v;
+}
+
+// Grid dimensions only, no cell arrays
+static inline ReconGrid recon_grid_shape(int img_w, int img_h, int cell_size, GridLayout layout) {
+  ReconGrid g = {0};
   g.cell_size = cell_size;
   g.nx = (img_w + cell_size - 1) / cell_size;
   g.ny = (img_h + cell_size - 1) / cell_size;
-  g.n = g.nx * g.ny;
+  g.layout = layout;
+  g.blocks_x = (g.nx + GRID_BLOCK - 1) / GRID_BLOCK;
+  if (layout == GRID_LAYOUT_BLOCKED)
+    g.n = g.blocks_x * ((g.ny + GRID_BLOCK - 1) / GRID_BLOCK) * GRID_BLOCK * GRID_BLOCK;
+  else
+    g.n = g.nx * g.ny;
+  return g;
+}
+
+static inline void recon_grid_budget(ArenaBudget *b, const ReconGrid *g) {
+  for (int i = 0; i < 3; i++)
+    arena_budget(b, g->n * sizeof(float));
+}
+
+// Allocate reconstruction grid with the given storage layout
+static inline ReconGrid recon_grid_alloc_layout(Arena *arena, int img_w, int img_h, int cell_size, GridLayout layout) {
+  ReconGrid g = recon_grid_shape(img_w, img_h, cell_size, layout);
   g.values = (float *)arena_alloc_zero(arena, g.n * sizeof(float));
-  g.ground_truth = (float *)arena_alloc(arena, g.n * sizeof(float));
+  g.ground_truth = (float *)arena_alloc_zero(arena, g.n * sizeof(float));
   g.row_buffer = (float *)arena_alloc(arena, g.n * sizeof(float));
+  recon_grid_touch_all(&g);
   return g;
 }
 
-// Build ground truth grid from source image (downsample)
-// Values are normalized to [0, 1] range for numerical stability
-static inline void recon_grid_build_truth(ReconGrid *g, const unsigned char *pixels, int img_w, int img_h) {
-  for (int iy = 0; iy < g->ny; iy++) {
-    for (int ix = 0; ix < g->nx; ix++) {
-      float sum = 0.0f;
-      int count = 0;
-
-      for (int yy = 0; yy < g->cell_size; yy++) {
-        for (int xx = 0; xx < g->cell_size; xx++) {
-          int px = ix * g->cell_size + xx;
-          int py = iy * g->cell_size + yy;
-          if (px < img_w && py < img_h) {
-            sum += pixels[py * img_w + px];
-            count++;
-          }
-        }
-      }
+// Allocate row-major reconstruction grid
+static inline ReconGrid recon_grid_alloc(Arena *arena, int img_w, int img_h, int cell_size) {
+  return recon_grid_alloc_layout(arena, img_w, img_h, cell_size, GRID_LAYOUT_ROW_MAJOR);
+}
 
-      g->ground_truth[iy * g->nx + ix] = sum / count / 255.0f;
+typedef struct {
+  ReconGrid *g;
+  const unsigned char *pixels;
+  int img_w, img_h;
+  uint32_t *col_sums; // img_w per thread
+} TruthJob;
+
+// Box-filter one band of cell rows. Each band first sums its pixel rows per
+// column, a plain loop over the full image width that the compiler
+// vectorizes. Cells then add cell_size neighbouring column sums; only the last
+// column and row of cells can be partial and need a pixel count.
+static inline void truth_rows(void *ctx, size_t begin, size_t end, int thread) {
+  TruthJob *job = (TruthJob *)ctx;
+  ReconGrid *g = job->g;
+  int w = job->img_w;
+  int cs = g->cell_size;
+  uint32_t *col = job->col_sums + (size_t)thread * w;
+
+  for (int iy = (int)begin; iy < (int)end; iy++) {
+    int py0 = iy * cs;
+    int py1 = py0 + cs < job->img_h ? py0 + cs : job->img_h;
+
+    const unsigned char *row = job->pixels + (size_t)py0 * w;
+    for (int px = 0; px < w; px++)
+      col[px] = row[px];
+    for (int py = py0 + 1; py < py1; py++) {
+      row = job->pixels + (size_t)py * w;
+      for (int px = 0; px < w; px++)
+        col[px] += row[px];
+    }
+
+    int rows = py1 - py0;
+    for (int ix = 0; ix < g->nx; ix++) {
+      int px0 = ix * cs;
+      int px1 = px0 + cs < w ? px0 + cs : w;
+      uint32_t sum = 0;
+      for (int px = px0; px < px1; px++)
+        sum += col[px];
+      // Integer sums stay exact in float, so this matches a per-pixel float sum
+      g->ground_truth[recon_grid_index(g, ix, iy)] = (float)sum / (float)((px1 - px0) * rows) / 255.0f;
     }
   }
 }
 
+// Build ground truth grid from source image (box-filter downsample),
+// multithreaded over cell rows. Values are normalized to [0, 1] range for
+// numerical stability.
+static inline void recon_grid_build_truth(Arena *arena, ReconGrid *g, const unsigned char *pixels, int img_w, int img_h) {
+  ArenaMark mark = arena_mark(arena);
+  TruthJob job = {g, pixels, img_w, img_h};
+  job.col_sums = (uint32_t *)arena_alloc(arena, (size_t)parallel_num_threads() * img_w * sizeof(uint32_t));
+  parallel_for((size_t)g->ny, truth_rows, &job);
+  arena_rewind(arena, mark);
+}
+
+static inline void recon_grid_build_truth_budget(ArenaBudget *b, int img_w) {
+  arena_budget(b, (size_t)parallel_num_threads() * img_w * sizeof(uint32_t));
+}
+
+// Liang-Barsky against one cell, taken as half-open [xmin, xmax) x [ymin, ymax)
+// so that an axis-aligned ray on a shared border counts for one cell only
+static inline LiangBarskyResult recon_cell_hit(const Rect *cell, const CTRay *ray) {
+  if ((ray->dx == 0.0f && ray->ox >= cell->xmax) || (ray->dy == 0.0f && ray->oy >= cell->ymax))
+    return (LiangBarskyResult){.intersects = false};
+  return liang_barsky_ray(cell, ray->ox, ray->oy, ray->dx, ray->dy);
+}
+
 // Build system matrix row for a single ray
 static inline void recon_build_row(ReconGrid *g, const CTRay *ray) {
   for (int i = 0; i < g->n; i++)
@@ -62,34 +218,106 @@ static inline void recon_build_row(ReconGrid *g, const CTRay *ray) {
       Rect cell = {(float)(ix * g->cell_size), (float)(iy * g->cell_size),
                    (float)((ix + 1) * g->cell_size), (float)((iy + 1) * g->cell_size)};
 
-      LiangBarskyResult hit =
-          liang_barsky_ray(&cell, ray->ox, ray->oy, ray->dx, ray->dy);
+      LiangBarskyResult hit = recon_cell_hit(&cell, ray);
       if (hit.intersects) {
         // Normalize by cell size so weights are ~1 per cell instead of ~4
-        g->row_buffer[iy * g->nx + ix] = hit.length / (float)g->cell_size;
+        g->row_buffer[recon_grid_index(g, ix, iy)] = hit.length / (float)g->cell_size;
+      }
+    }
+  }
+}
+
+// Build only the non-zero entries of a ray's system matrix row, in ascending
+// storage order. Each grid row band is clipped to the ray first, so only the few
+// cells around the crossing are tested instead of the whole grid.
+// cols/weights need room for nx + ny entries. Returns the entry count.
+static inline int recon_build_row_sparse(const ReconGrid *g, const CTRay *ray, int *cols, float *weights) {
+  float cs = (float)g->cell_size;
+  int count = 0;
+
+  for (int iy = 0; iy < g->ny; iy++) {
+    float y0 = (float)(iy * g->cell_size);
+    float y1 = (float)((iy + 1) * g->cell_size);
+
+    // Ray parameter range inside this band (t >= 0)
+    float tmin, tmax;
+    if (ray->dy != 0.0f) {
+      float ta = (y0 - ray->oy) / ray->dy;
+      float tb = (y1 - ray->oy) / ray->dy;
+      tmin = fmaxf(fminf(ta, tb), 0.0f);
+      tmax = fmaxf(ta, tb);
+      if (tmax < 0.0f)
+        continue;
+    } else {
+      if (ray->oy < y0 || ray->oy >= y1)
+        continue;
+      tmin = 0.0f;
+      tmax = INFINITY;
+    }
+
+    float xa = ray->ox + ray->dx * tmin;
+    float xb = isinf(tmax) ? (ray->dx > 0.0f ? INFINITY : ray->dx < 0.0f ? -INFINITY : ray->ox)
+                           : ray->ox + ray->dx * tmax;
+    float lo = fmaxf(fminf(xa, xb), -cs);
+    float hi = fminf(fmaxf(xa, xb), (float)(g->nx + 1) * cs);
+
+    // One cell of slack on each side absorbs rounding at cell borders
+    int ix0 = (int)floorf(lo / cs) - 1;
+    int ix1 = (int)floorf(hi / cs) + 1;
+    if (ix0 < 0)
+      ix0 = 0;
+    if (ix1 > g->nx - 1)
+      ix1 = g->nx - 1;
+
+    for (int ix = ix0; ix <= ix1; ix++) {
+      Rect cell = {(float)(ix * g->cell_size), y0, (float)((ix + 1) * g->cell_size), y1};
+      LiangBarskyResult hit = recon_cell_hit(&cell, ray);
+      if (hit.intersects && hit.length > 0.0f) {
+        cols[count] = recon_grid_index(g, ix, iy);
+        weights[count] = hit.length / cs;
+        count++;
+      }
+    }
+  }
+
+  // Blocked storage is not monotonic across grid rows. Entries come out
+  // nearly sorted (only within a block row), so insertion sort is cheap.
+  if (g->layout != GRID_LAYOUT_ROW_MAJOR) {
+    for (int i = 1; i < count; i++) {
+      int c = cols[i];
+      float w = weights[i];
+      int j = i - 1;
+      for (; j >= 0 && cols[j] > c; j--) {
+        cols[j + 1] = cols[j];
+        weights[j + 1] = weights[j];
       }
+      cols[j + 1] = c;
+      weights[j + 1] = w;
     }
   }
+  return count;
 }
 
 // Compute projection value for a ray (dot product with ground truth)
 static inline float recon_compute_projection(ReconGrid *g, const CTRay *ray) {
   recon_build_row(g, ray);
 
-  float b = 0.0f;
+  ReconSum b = recon_sum_zero();
   for (int i = 0; i < g->n; i++)
-    b += g->ground_truth[i] * g->row_buffer[i];
-  return b;
+    recon_sum_add(&b, g->ground_truth[i] * g->row_buffer[i]);
+  return recon_sum_value(b);
 }
 
 // Classic Kaczmarz iteration step
 static inline void recon_kaczmarz_step(ReconGrid *g, float projection) {
-  float ax = 0.0f, norm_a = 0.0f;
+  ReconSum ax_sum = recon_sum_zero(), norm_sum = recon_sum_zero();
 
   for (int i = 0; i < g->n; i++) {
-    ax += g->row_buffer[i] * g->values[i];
-    norm_a += g->row_buffer[i] * g->row_buffer[i];
+    recon_sum_add(&ax_sum, g->row_buffer[i] * g->values[i]);
+    recon_sum_add(&norm_sum, g->row_buffer[i] * g->row_buffer[i]);
   }
+  float ax = recon_sum_value(ax_sum);
+  float norm_a = recon_sum_value(norm_sum);
 
   if (norm_a < 1e-12f)
     return;
@@ -99,6 +327,7 @@ static inline void recon_kaczmarz_step(ReconGrid *g, float projection) {
   for (int i = 0; i < g->n; i++) {
     g->values[i] += alpha * g->row_buffer[i];
   }
+  recon_grid_touch_all(g);
 }
 
 // Process a single ray: build row, then apply Kaczmarz
@@ -107,21 +336,54 @@ static inline void recon_process_ray(ReconGrid *g, const CTRay *ray, float proje
   recon_kaczmarz_step(g, projection);
 }
 
-// Precompute all projections for a ray set
-static inline void recon_precompute_projections(ReconGrid *g, RaySet *rs) {
-  for (size_t i = 0; i < rs->count; i++) {
-    rs->projections[i] = recon_compute_projection(g, &rs->rays[i]);
+typedef struct {
+  const ReconGrid *g;
+  RaySet *rs;
+  int *cols;      // nx + ny per thread
+  float *weights; // nx + ny per thread
+} ProjectionJob;
+
+static inline void projection_rays(void *ctx, size_t begin, size_t end, int thread) {
+  ProjectionJob *job = (ProjectionJob *)ctx;
+  const ReconGrid *g = job->g;
+  size_t max_row = (size_t)(g->nx + g->ny);
+  int *cols = job->cols + (size_t)thread * max_row;
+  float *weights = job->weights + (size_t)thread * max_row;
+
+  for (size_t i = begin; i < end; i++) {
+    int count = recon_build_row_sparse(g, &job->rs->rays[i], cols, weights);
+    ReconSum b = recon_sum_zero();
+    for (int k = 0; k < count; k++)
+      recon_sum_add(&b, g->ground_truth[cols[k]] * weights[k]);
+    job->rs->projections[i] = recon_sum_value(b);
   }
 }
 
+// Precompute all projections for a ray set from sparse rows, multithreaded
+// over rays. The entries are summed in storage order, like the dense
+// recon_compute_projection, so the result is the same.
+static inline void recon_precompute_projections(Arena *arena, const ReconGrid *g, RaySet *rs) {
+  ArenaMark mark = arena_mark(arena);
+  size_t max_row = (size_t)(g->nx + g->ny) * parallel_num_threads();
+  ProjectionJob job = {g, rs};
+  job.cols = (int *)arena_alloc(arena, max_row * sizeof(int));
+  job.weights = (float *)arena_alloc(arena, max_row * sizeof(float));
+  parallel_for(rs->count, projection_rays, &job);
+  arena_rewind(arena, mark);
+}
+
+static inline void recon_precompute_projections_budget(ArenaBudget *b, const ReconGrid *g) {
+  size_t max_row = (size_t)(g->nx + g->ny) * parallel_num_threads();
+  arena_budget(b, max_row * sizeof(int));
+  arena_budget(b, max_row * sizeof(float));
+}
+
 // Run one iteration over all rays from a fan source
 static inline void recon_iterate_fan(ReconGrid *g, const RaySet *rs, size_t iteration) {
-  if (rs->type != RAY_MODE_FAN) {
+  size_t begin, end;
+  if (!rayset_fan_rows(rs, iteration, &begin, &end))
     return;
-  }
-  size_t startIndex = iteration * rs->metadata.fan.num_rays_per_source;
-  size_t endIndex = startIndex + rs->metadata.fan.num_rays_per_source;
-  for (size_t i = startIndex; i < endIndex; i++) {
+  for (size_t i = begin; i < end; i++) {
     recon_process_ray(g, &rs->rays[i], rs->projections[i]);
   }
 }
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "matrix.h"
+#include "parallel.h"
+
+// Deterministic parallel Kaczmarz by row coloring.
+//
+// Two rays conflict when they cross a common cell. Rows are colored so that
+// no two rows of a color conflict; the Kaczmarz steps of one color then touch
+// disjoint cells and can run on any number of threads with no atomics. A
+// sweep goes color by color, and within a color each row reads and writes
+// only its own cells, so the result is bit-identical to running the rows one
+// after another in that order, for every thread count.
+//
+// Coloring is greedy first-fit in row (source) order. The conflict graph is
+// never built: every cell keeps a bitset of the colors of the rows through it,
+// and a row takes the lowest color missing from the union over its cells.
+// Rows stay in ascending order inside a color.
+//
+// A color can hold at most one of the rays through the busiest cell, so the
+// parallelism is about rows / (max rays per cell). Colors with too little work
+// to be worth waking the pool run inline; the result is the same either way.
+
+#define COLORED_MIN_PARALLEL_ENTRIES 4096
+
+typedef struct {
+  int num_colors;
+  uint32_t *color_start; // num_colors + 1 offsets into rows
+  uint32_t *rows;        // Rows grouped by color
+} ReconColoring;
+
+static inline ReconColoring recon_coloring_build(Arena *arena, const ReconMatrix *m, int n) {
+  ReconColoring c = {0};
+  c.rows = (uint32_t *)arena_alloc(arena, m->rows * sizeof(uint32_t));
+  // Sized for the worst case of one color per row
+  c.color_start = (uint32_t *)arena_alloc_zero(arena, (m->rows + 1) * sizeof(uint32_t));
+
+  ArenaMark mark = arena_mark(arena);
+  uint32_t *row_color = (uint32_t *)arena_alloc(arena, m->rows * sizeof(uint32_t));
+  int words = 1; // 64-bit words per cell bitset, doubled when the colors run out
+  uint64_t *cell_colors = (uint64_t *)arena_alloc_zero(arena, (size_t)n * words * sizeof(uint64_t));
+  uint64_t *used = (uint64_t *)arena_alloc(arena, words * sizeof(uint64_t));
+
+  for (size_t r = 0; r < m->rows; r++) {
+    uint32_t start = m->row_start[r];
+    uint32_t end = m->row_start[r + 1];
+
+    memset(used, 0, words * sizeof(uint64_t));
+    uint32_t col = m->col0[r];
+    for (uint32_t k = start; k < end; k++) {
+      col += m->col_delta[k];
+      for (int w = 0; w < words; w++)
+        used[w] |= cell_colors[(size_t)col * words + w];
+    }
+
+    int color = -1;
+    for (int w = 0; w < words && color < 0; w++)
+      if (~used[w])
+        color = w * 64 + __builtin_ctzll(~used[w]);
+    if (color < 0) {
+      uint64_t *grown = (uint64_t *)arena_alloc_zero(arena, (size_t)n * 2 * words * sizeof(uint64_t));
+      for (int j = 0; j < n; j++)
+        memcpy(grown + (size_t)j * 2 * words, cell_colors + (size_t)j * words, words * sizeof(uint64_t));
+      cell_colors = grown;
+      used = (uint64_t *)arena_alloc(arena, 2 * words * sizeof(uint64_t));
+      color = words * 64;
+      words *= 2;
+    }
+
+    row_color[r] = (uint32_t)color;
+    if (color + 1 > c.num_colors)
+      c.num_colors = color + 1;
+    col = m->col0[r];
+    for (uint32_t k = start; k < end; k++) {
+      col += m->col_delta[k];
+      cell_colors[(size_t)col * words + color / 64] |= 1ull << (color % 64);
+    }
+  }
+
+  // Counting sort by color keeps the rows ascending within each color
+  for (size_t r = 0; r < m->rows; r++)
+    c.color_start[row_color[r] + 1]++;
+  for (int k = 0; k < c.num_colors; k++)
+    c.color_start[k + 1] += c.color_start[k];
+  uint32_t *next = (uint32_t *)arena_alloc(arena, c.num_colors * sizeof(uint32_t));
+  memcpy(next, c.color_start, c.num_colors * sizeof(uint32_t));
+  for (size_t r = 0; r < m->rows; r++)
+    c.rows[next[row_color[r]]++] = (uint32_t)r;
+
+  arena_rewind(arena, mark);
+  return c;
+}
+
+// A row takes at most one color more than there are rows before it, so the
+// cell bitsets double at most until they have a bit per row
+static inline void recon_coloring_budget(ArenaBudget *b, size_t rows, int n) {
+  arena_budget(b, rows * sizeof(uint32_t));
+  arena_budget(b, (rows + 1) * sizeof(uint32_t));
+  arena_budget(b, rows * sizeof(uint32_t));
+  for (size_t words = 1;; words *= 2) {
+    arena_budget(b, (size_t)n * words * sizeof(uint64_t));
+    arena_budget(b, words * sizeof(uint64_t));
+    if (words * 64 >= rows)
+      break;
+  }
+  arena_budget(b, rows * sizeof(uint32_t));
+}
+
+typedef struct {
+  const ReconMatrix *m;
+  const uint32_t *rows;
+  float *x;
+  const float *b;
+  ReconBounds bounds;
+} ColoredJob;
+
+static inline void colored_rows(void *ctx, size_t begin, size_t end, int thread) {
+  ColoredJob *job = (ColoredJob *)ctx;
+  for (size_t i = begin; i < end; i++) {
+    uint32_t r = job->rows[i];
+    recon_matrix_kaczmarz_row_clamp(job->m, r, job->x, job->b[r], job->bounds);
+  }
+}
+
+// Matrix entries in the rows of one color
+static inline size_t recon_coloring_entries(const ReconColoring *c, const ReconMatrix *m, int color) {
+  size_t entries = 0;
+  for (uint32_t i = c->color_start[color]; i < c->color_start[color + 1]; i++)
+    entries += m->row_start[c->rows[i] + 1] - m->row_start[c->rows[i]];
+  return entries;
+}
+
+// Colors with enough entries to be split across the workers
+static inline int recon_coloring_parallel_colors(const ReconColoring *c, const ReconMatrix *m) {
+  int count = 0;
+  for (int k = 0; k < c->num_colors; k++)
+    count += recon_coloring_entries(c, m, k) >= COLORED_MIN_PARALLEL_ENTRIES;
+  return count;
+}
+
+// Constrained Kaczmarz steps for every row of one color, in parallel
+static inline void recon_colored_kaczmarz(const ReconColoring *c, const ReconMatrix *m, ReconGrid *g, const float *b, int color,
+                                          ReconBounds bounds) {
+  uint32_t begin = c->color_start[color];
+  uint32_t end = c->color_start[color + 1];
+  ColoredJob job = {m, c->rows + begin, g->values, b, bounds};
+
+  if (recon_coloring_entries(c, m, color) < COLORED_MIN_PARALLEL_ENTRIES)
+    colored_rows(&job, 0, end - begin, 0);
+  else
+    parallel_for(end - begin, colored_rows, &job);
+
+  for (uint32_t i = begin; i < end; i++)
+    recon_grid_touch(g, m->row_rect[c->rows[i]]);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "arena.h"
+#include "projector.h"
+#include <math.h>
+
+// Krylov least-squares solvers (CGLS and LSQR) for A x = b.
+//
+// Both start from the current contents of x and advance by one iteration per
+// step call, so they can be driven a few steps per frame like Kaczmarz.
+// Each step costs one forward and one back projection, both multithreaded.
+
+static inline double vec_dot(const float *a, const float *b, size_t n) {
+  double sum = 0.0;
+  for (size_t i = 0; i < n; i++)
+    sum += (double)a[i] * b[i];
+  return sum;
+}
+
+// y += alpha * x
+static inline void vec_axpy(float *y, float alpha, const float *x, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    y[i] += alpha * x[i];
+}
+
+// y = x + beta * y
+static inline void vec_xpby(float *y, const float *x, float beta, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    y[i] = x[i] + beta * y[i];
+}
+
+static inline void vec_scale(float *x, float s, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    x[i] *= s;
+}
+
+// Conjugate gradients on the normal equations A^T A x = A^T b
+typedef struct {
+  const ReconProjector *proj;
+  const float *b;
+  float *x;
+  float *r; // b - A x (rows)
+  float *q; // A p (rows)
+  float *s; // A^T r (cells)
+  float *p; // Search direction (cells)
+  double gamma;
+  double residual; // ||b - A x||
+  int iteration;
+} CglsSolver;
+
+static inline CglsSolver cgls_init(Arena *arena, const ReconProjector *proj, const float *b, float *x) {
+  size_t rows = proj->m->rows;
+  size_t n = (size_t)proj->n;
+  CglsSolver c = {.proj = proj, .b = b, .x = x, .iteration = 0};
+  c.r = (float *)arena_alloc(arena, rows * sizeof(float));
+  c.q = (float *)arena_alloc(arena, rows * sizeof(float));
+  c.s = (float *)arena_alloc(arena, n * sizeof(float));
+  c.p = (float *)arena_alloc(arena, n * sizeof(float));
+
+  recon_project_forward(proj, x, c.r);
+  for (size_t i = 0; i < rows; i++)
+    c.r[i] = b[i] - c.r[i];
+  recon_project_back(proj, c.r, c.s);
+  memcpy(c.p, c.s, n * sizeof(float));
+
+  c.gamma = vec_dot(c.s, c.s, n);
+  c.residual = sqrt(vec_dot(c.r, c.r, rows));
+  return c;
+}
+
+static inline void cgls_budget(ArenaBudget *b, size_t rows, int n) {
+  arena_budget(b, rows * sizeof(float));
+  arena_budget(b, rows * sizeof(float));
+  arena_budget(b, n * sizeof(float));
+  arena_budget(b, n * sizeof(float));
+}
+
+// One CGLS iteration, returns false once the normal residual vanished
+static inline bool cgls_step(CglsSolver *c) {
+  size_t rows = c->proj->m->rows;
+  size_t n = (size_t)c->proj->n;
+  if (c->gamma < 1e-30)
+    return false;
+
+  recon_project_forward(c->proj, c->p, c->q);
+  double qq = vec_dot(c->q, c->q, rows);
+  if (qq < 1e-30)
+    return false;
+
+  float alpha = (float)(c->gamma / qq);
+  vec_axpy(c->x, alpha, c->p, n);
+  vec_axpy(c->r, -alpha, c->q, rows);
+
+  recon_project_back(c->proj, c->r, c->s);
+  double gamma = vec_dot(c->s, c->s, n);
+  vec_xpby(c->p, c->s, (float)(gamma / c->gamma), n);
+
+  c->gamma = gamma;
+  c->residual = sqrt(vec_dot(c->r, c->r, rows));
+  c->iteration++;
+  return true;
+}
+
+// LSQR (Paige & Saunders) via Golub-Kahan bidiagonalization
+typedef struct {
+  const ReconProjector *proj;
+  float *x;
+  float *u;  // Left Lanczos vector (rows)
+  float *v;  // Right Lanczos vector (cells)
+  float *w;  // Update direction (cells)
+  float *av; // Scratch for A v (rows)
+  float *atu; // Scratch for A^T u (cells)
+  double alpha, beta;
+  double phibar, rhobar;
+  double residual; // Estimate of ||b - A x||
+  int iteration;
+} LsqrSolver;
+
+static inline LsqrSolver lsqr_init(Arena *arena, const ReconProjector *proj, const float *b, float *x) {
+  size_t rows = proj->m->rows;
+  size_t n = (size_t)proj->n;
+  LsqrSolver l = {.proj = proj, .x = x, .iteration = 0};
+  l.u = (float *)arena_alloc(arena, rows * sizeof(float));
+  l.v = (float *)arena_alloc(arena, n * sizeof(float));
+  l.w = (float *)arena_alloc(arena, n * sizeof(float));
+  l.av = (float *)arena_alloc(arena, rows * sizeof(float));
+  l.atu = (float *)arena_alloc(arena, n * sizeof(float));
+
+  // Solve for the correction to the starting x: beta u = b - A x
+  recon_project_forward(proj, x, l.u);
+  for (size_t i = 0; i < rows; i++)
+    l.u[i] = b[i] - l.u[i];
+  l.beta = sqrt(vec_dot(l.u, l.u, rows));
+  if (l.beta > 0.0)
+    vec_scale(l.u, (float)(1.0 / l.beta), rows);
+
+  recon_project_back(proj, l.u, l.v);
+  l.alpha = sqrt(vec_dot(l.v, l.v, n));
+  if (l.alpha > 0.0)
+    vec_scale(l.v, (float)(1.0 / l.alpha), n);
+
+  memcpy(l.w, l.v, n * sizeof(float));
+  l.phibar = l.beta;
+  l.rhobar = l.alpha;
+  l.residual = l.beta;
+  return l;
+}
+
+static inline void lsqr_budget(ArenaBudget *b, size_t rows, int n) {
+  arena_budget(b, rows * sizeof(float));
+  for (int i = 0; i < 3; i++)
+    arena_budget(b, n * sizeof(float));
+  arena_budget(b, rows * sizeof(float));
+}
+
+// One LSQR iteration, returns false on breakdown (exact solution reached)
+static inline bool lsqr_step(LsqrSolver *l) {
+  size_t rows = l->proj->m->rows;
+  size_t n = (size_t)l->proj->n;
+  if (l->alpha <= 0.0 || l->beta <= 0.0)
+    return false;
+
+  // beta u = A v - alpha u
+  recon_project_forward(l->proj, l->v, l->av);
+  vec_xpby(l->u, l->av, (float)-l->alpha, rows);
+  l->beta = sqrt(vec_dot(l->u, l->u, rows));
+  if (l->beta > 0.0)
+    vec_scale(l->u, (float)(1.0 / l->beta), rows);
+
+  // alpha v = A^T u - beta v
+  recon_project_back(l->proj, l->u, l->atu);
+  vec_xpby(l->v, l->atu, (float)-l->beta, n);
+  l->alpha = sqrt(vec_dot(l->v, l->v, n));
+  if (l->alpha > 0.0)
+    vec_scale(l->v, (float)(1.0 / l->alpha), n);
+
+  // Plane rotation eliminating the subdiagonal beta
+  double rho = sqrt(l->rhobar * l->rhobar + l->beta * l->beta);
+  double c = l->rhobar / rho;
+  double s = l->beta / rho;
+  double theta = s * l->alpha;
+  double phi = c * l->phibar;
+  l->rhobar = -c * l->alpha;
+  l->phibar = s * l->phibar;
+
+  vec_axpy(l->x, (float)(phi / rho), l->w, n);
+  vec_xpby(l->w, l->v, (float)(-theta / rho), n);
+
+  l->residual = fabs(l->phibar);
+  l->iteration++;
+  return true;
+}
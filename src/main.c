@@ -1,10 +1,23 @@
 #include "arena.h"
 #include "art.h"
+#include "colored.h"
+#include "krylov.h"
+#include "matrix.h"
+#include "multigrid.h"
+#include "noise.h"
+#include "osem.h"
+#include "profile.h"
+#include "sart.h"
+#include "simulate.h"
+#include "sirt.h"
+#include "symmetry.h"
+#include "tv.h"
 #include "ray.h"
 #include "raylib.h"
 #include "rlgl.h"
 #include "ui.h"
 #include "utils.h"
+#include <time.h>
 
 typedef enum {
   APP_STAGE_SCAN_GRID = 0,
@@ -16,6 +29,18 @@ typedef enum {
   APP_STAGE_LOADING = 6,
 } AppStage;
 
+typedef enum {
+  SOLVER_KACZMARZ = 0,
+  SOLVER_CGLS = 1,
+  SOLVER_LSQR = 2,
+  SOLVER_MULTIGRID = 3,
+  SOLVER_OSEM = 4,
+  SOLVER_ART_TV = 5,
+  SOLVER_SART = 6,
+  SOLVER_SIRT = 7,
+  SOLVER_KACZMARZ_COLORED = 8,
+} ReconSolver;
+
 typedef struct {
   float offset_x;
   float offset_y;
@@ -39,11 +64,37 @@ AppStage stage = APP_STAGE_SCAN_GRID;
 AppStage old_stage = APP_STAGE_LOADING;
 
 size_t GRID_CELL_SIZE = 5;
+GridLayout GRID_LAYOUT = GRID_LAYOUT_BLOCKED; // Cell storage order
 size_t NUM_SOURCES = 360;
 size_t RAYS_PER_SOURCE = 30;     // Dense angular sampling
 float RAYS_SPREAD_ANGLE = 30.0f; // Wide enough to cover corners
-
-#define ITERATIONS_PER_FRAME 16
+MatrixFormat MATRIX_FORMAT = MATRIX_Q8; // System matrix weight storage
+// Kaczmarz stores only the rows of one symmetry sector of the fan (symmetry.h)
+// and derives the rest; the grid falls back to row-major order for it
+bool SYMMETRIC_MATRIX = false;
+ReconSolver SOLVER = SOLVER_KACZMARZ;
+ReconBounds BOUNDS = {0.0f, 1.0f}; // Value range for Kaczmarz, ART-TV, SART, SIRT and multigrid
+float SART_LAMBDA = 1.0f;          // SART / SIRT relaxation
+int MULTIGRID_LEVELS = 3; // Grid pyramid depth for SOLVER_MULTIGRID
+int OSEM_SUBSETS = 8;     // Source fan subsets for SOLVER_OSEM
+int TV_STEPS = 10;        // TV descent steps between sweeps for SOLVER_ART_TV
+float TV_ALPHA = 0.05f;   // TV step length relative to the sweep's change
+// Sub-rays per ray when simulating the projections from the full-resolution
+// slice; 0 projects the downsampled ground truth instead (the inverse crime).
+// Off by default: with the model mismatch the solvers semi-converge, and
+// their RMSE climbs again after a minimum (multigrid's soonest).
+int SIM_SUB_RAYS = 0;
+// Detector noise on the projections, simulated or projected from the ground
+// truth alike (i0 = 0 keeps them exact)
+ReconNoise NOISE = {.i0 = 1e6f, .electronic = 10.0f, .scale = 1.0f, .seed = 1};
+
+float SOLVE_BUDGET_MS = 10.0f;    // Solver time per frame, of the 16.7 ms at 60 FPS
+float TEXTURE_REFRESH_HZ = 20.0f; // Reconstruction / error texture uploads per second
+
+#define BENCH_FAN_STEPS 16 // Fans per benchmark frame for the per-fan solvers (or as many rows, for colored Kaczmarz)
+#define BENCH_RMSE_RISE 0.05 // RMSE rise over a benchmark run, relative to its minimum, that gets flagged
+#define BENCH_SIM_SUB_RAYS 4 // SIM_SUB_RAYS for --bench-realistic
+#define PROFILE_TRACE_PATH "trace.json" // Written on exit and on the T key (make PROFILE=1)
 
 int gWidth = 640;
 int gHeight = 480;
@@ -54,11 +105,29 @@ EM_JS(int, canvas_w, (), { return Module.canvas.clientWidth; });
 EM_JS(int, canvas_h, (), { return Module.canvas.clientHeight; });
 EM_JS(void, set_stage, (int app_stage), { stage = app_stage; });
 EM_JS(void, hide_loader, (), { Module.setStatus(''); });
+// Hand a file from the in-memory filesystem to the browser as a download
+EM_JS(void, download_file, (const char *path), {
+  var name = UTF8ToString(path);
+  var link = document.createElement('a');
+  link.href = URL.createObjectURL(new Blob([FS.readFile(name)]));
+  link.download = name;
+  link.click();
+  URL.revokeObjectURL(link.href);
+});
 
 EMSCRIPTEN_KEEPALIVE
 void setStage(int stageFromJs) {
   stage = stageFromJs;
 }
+#else
+static void hide_loader(void) {}
+static void download_file(const char *path) {}
+#endif
+
+#ifdef ARENA_TRACE
+void arena_trace_log(void *user, const char *file, int line, size_t size) {
+  TraceLog(LOG_DEBUG, "arena: %zu bytes at %s:%d", size, file, line);
+}
 #endif
 
 void UpdateCanvasInfo() {
@@ -69,143 +138,552 @@ void UpdateCanvasInfo() {
 #endif
 }
 
-int main(void) {
-  SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE);
-  UpdateCanvasInfo();
-  InitWindow(gWidth, gHeight, "Kaczmarz Reconstruction");
-  hide_loader();
+// Everything the frame callback needs. Static storage: on the web, main
+// returns into the browser's event loop while frames keep running, and the
+// solvers keep pointers into each other (projector, grid, rays).
+typedef struct {
+  UIState ui;
+  Arena *arena;
+  Image img;
+  int img_w, img_h;
+  int src_idx;
+  size_t ray_frame;
+
+  RaySet rays;
+  ReconGrid rgrid;
+  ReconMatrix sysm;
+  ReconSymMatrix symm; // Instead of sysm with SYMMETRIC_MATRIX
+  ReconProjector proj;
+  CglsSolver cgls;
+  LsqrSolver lsqr;
+  OsemSolver osem;
+  ReconSart sart;
+  ReconTiledProjector tiled;
+  ReconSirt sirt;
+  ReconTv tv;
+  ReconPyramid pyramid;
+  ReconColoring coloring;
+  int color;
+
+  Texture2D src_tex, recon_tex, error_tex;
+  unsigned char *recon_px;
+  Color *error_px;
+  UIRayCache ray_cache;
+
+  double step_ms;      // Running average cost of one app_step
+  double last_refresh; // Time of the last texture upload
+} App;
+
+static App app;
+
+static double app_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
 
-  unsigned char *originalPixels = NULL;
-  Image img = LoadPGM("./resources/nii_slices/slice_0128.pgm", &originalPixels);
-  if (!img.data) {
-    CloseWindow();
-    return 1;
+// Advance the solver by one step: a source fan for Kaczmarz, ART-TV and SART,
+// a color class for colored Kaczmarz, a stage of the V-cycle for multigrid,
+// a full iteration (or OS-EM subset) for the others
+static void app_step(App *a) {
+  switch (SOLVER) {
+  case SOLVER_KACZMARZ: {
+    PROFILE_ZONE("recon_iterate_fan");
+    if (a->symm.base.row_start)
+      recon_symmatrix_iterate_fan_clamp(&a->symm, &a->rgrid, &a->rays, a->src_idx, BOUNDS);
+    else
+      recon_matrix_iterate_fan_clamp(&a->sysm, &a->rgrid, &a->rays, a->src_idx, BOUNDS);
+    a->src_idx = (a->src_idx + 1) % NUM_SOURCES;
+    a->ui.iteration++;
+    break;
+  }
+  case SOLVER_KACZMARZ_COLORED: {
+    PROFILE_ZONE("recon_colored_kaczmarz");
+    recon_colored_kaczmarz(&a->coloring, &a->sysm, &a->rgrid, a->rays.projections, a->color, BOUNDS);
+    a->color = (a->color + 1) % a->coloring.num_colors;
+    a->ui.iteration++;
+    break;
+  }
+  case SOLVER_SART: {
+    PROFILE_ZONE("recon_sart_iterate_fan");
+    recon_sart_iterate_fan(&a->sysm, &a->sart, &a->rgrid, &a->rays, a->src_idx, BOUNDS);
+    a->src_idx = (a->src_idx + 1) % NUM_SOURCES;
+    a->ui.iteration++;
+    break;
+  }
+  case SOLVER_SIRT: {
+    PROFILE_ZONE("recon_sirt_step");
+    recon_sirt_step(&a->sirt, a->rgrid.values, a->rays.projections, BOUNDS);
+    recon_grid_touch_all(&a->rgrid);
+    a->ui.iteration++;
+    break;
+  }
+  case SOLVER_ART_TV:
+    // Same fan order as Kaczmarz, with TV steps after every full sweep
+    if (a->src_idx == 0)
+      recon_tv_begin(&a->tv, a->rgrid.values);
+    {
+      PROFILE_ZONE("recon_iterate_fan");
+      recon_matrix_iterate_fan_clamp(&a->sysm, &a->rgrid, &a->rays, a->src_idx, BOUNDS);
+    }
+    a->src_idx = (a->src_idx + 1) % NUM_SOURCES;
+    if (a->src_idx == 0) {
+      PROFILE_ZONE("recon_tv_minimize");
+      recon_tv_minimize(&a->tv, a->rgrid.values);
+      recon_grid_touch_all(&a->rgrid);
+    }
+    a->ui.iteration++;
+    break;
+  case SOLVER_CGLS: {
+    PROFILE_ZONE("cgls_step");
+    if (cgls_step(&a->cgls))
+      a->ui.iteration++;
+    recon_grid_touch_all(&a->rgrid);
+    break;
+  }
+  case SOLVER_LSQR: {
+    PROFILE_ZONE("lsqr_step");
+    if (lsqr_step(&a->lsqr))
+      a->ui.iteration++;
+    recon_grid_touch_all(&a->rgrid);
+    break;
+  }
+  case SOLVER_MULTIGRID: {
+    PROFILE_ZONE("recon_pyramid_vcycle_step");
+    if (recon_pyramid_vcycle_step(&a->pyramid, 1, 1, BOUNDS))
+      a->ui.iteration++;
+    recon_grid_touch_all(&a->rgrid);
+    break;
+  }
+  case SOLVER_OSEM: {
+    PROFILE_ZONE("osem_step");
+    osem_step(&a->osem);
+    recon_grid_touch_all(&a->rgrid);
+    a->ui.iteration++;
+    break;
   }
+  }
+}
 
-  int img_w = img.width;
-  int img_h = img.height;
-  int src_idx = 0;
+// Run solver steps for about budget_ms. A step starts only while the running
+// average of its cost still fits in the time left, and every frame gets at
+// least one step, so slow devices degrade to one step per frame instead of
+// dropping frames by a fixed iteration count.
+static int app_solve(App *a, double budget_ms) {
+  double t = app_now();
+  double deadline = t + budget_ms * 1e-3;
+  int steps = 0;
+  while (steps == 0 || t + a->step_ms * 1e-3 <= deadline) {
+    app_step(a);
+    double done = app_now();
+    double ms = (done - t) * 1e3;
+    a->step_ms = a->step_ms > 0.0 ? a->step_ms + 0.1 * (ms - a->step_ms) : ms;
+    t = done;
+    steps++;
+  }
+  return steps;
+}
 
-  UIState ui = ui_state_init();
-  Arena *arena = arena_create();
+// Panels, labels and the ray animation, up to (not including) EndDrawing
+static void app_draw(App *a) {
+  int img_w = a->img_w;
+  int img_h = a->img_h;
+
+  BeginDrawing();
+  ClearBackground(UI_BG_COLOR);
+
+  // start zoomable canvas here
+  BeginScissorMode(0, 0, gWidth, gHeight);
+  rlPushMatrix();
+  if (old_stage != stage) {
+    a->ui.offset_x = stage_pos[stage].offset_x;
+    a->ui.offset_y = stage_pos[stage].offset_y;
+    a->ui.zoom = stage_pos[stage].zoom_level;
+    old_stage = stage;
+  }
+  rlTranslatef(a->ui.offset_x, a->ui.offset_y, 0);
+  rlScalef(a->ui.zoom, a->ui.zoom, 1.0f);
+
+  // do zoomable graphics here
+
+  UILayout layout = ui_compute_layout(0, 0, img_w, img_h, 0);
+  if (stage >= 0) {
+    const char *label = "Scanning original";
+    switch (stage) {
+    case APP_STAGE_SCAN_GRID:
+      label = "Sample brain scan";
+      break;
+    case APP_STAGE_SCAN_RAYS:
+      label = "Scan grid";
+      break;
+    case APP_STAGE_SCAN_IMAGE:
+      label = "Scanning rays";
+      break;
+    }
+    ui_draw_image_panel(a->src_tex, layout.x, layout.y, layout.padding, label);
+  }
+  if (stage >= 1) {
+    ui_draw_grid_overlay(layout.innerX, layout.innerY, img_w, img_h, 256 / 5, 256 / 5, 5);
+  }
 
-  RaySet rays = rayset_generate_fan(arena, NUM_SOURCES, RAYS_PER_SOURCE, RAYS_SPREAD_ANGLE);
-  ReconGrid rgrid = recon_grid_alloc(arena, img_w, img_h, GRID_CELL_SIZE);
+  // rays scan
+  if (stage == 2) {
+    // Rays stay in reconstruction space; only the view moves them
+    ui_begin_recon_view(layout.x, layout.y, layout.width, layout.height, a->rgrid.nx * a->rgrid.cell_size,
+                        a->rgrid.ny * a->rgrid.cell_size);
+    ui_draw_rays(&a->ray_cache, &a->rays, a->ray_frame);
+    ui_end_recon_view();
+    a->ray_frame = (a->ray_frame + 1) % NUM_SOURCES;
+  }
 
-  rayset_translate(&rays, 0, 0, img_w, img_h);
-  recon_grid_build_truth(&rgrid, originalPixels, img_w, img_h);
-  recon_precompute_projections(&rgrid, &rays);
+  next_panel(&layout, 0, gHeight);
+  ui_draw_grid_panel(a->recon_tex, a->rgrid.cell_size, img_w, img_h, layout.x, layout.y, layout.padding, "Kaczmarz Reconstruction");
+  DrawText(TextFormat("Iterations: %d", a->ui.iteration), layout.x + layout.width + layout.padding + 10, layout.innerY, 18, UI_TEXT_COLOR);
+  DrawText(TextFormat("Num sources: %d", NUM_SOURCES), layout.x + layout.width + layout.padding + 10, layout.innerY + 20, 18, UI_TEXT_COLOR);
+  DrawText(TextFormat("Rays per \n \tsource: %d", RAYS_PER_SOURCE), layout.x + layout.width + layout.padding + 10, layout.innerY + 40, 18, UI_TEXT_COLOR);
+
+  // Per-phase times of the last frames (profiling builds only)
+  const char *zone;
+  float zone_ms;
+  for (int z = 0; profile_hud(z, &zone, &zone_ms); z++)
+    DrawText(TextFormat("%s: %.2f ms", zone, zone_ms), layout.x + layout.width + layout.padding + 10, layout.innerY + 90 + z * 16, 14,
+             UI_TEXT_COLOR);
+
+  next_panel(&layout, 0, gHeight);
+  ui_draw_grid_panel(a->error_tex, a->rgrid.cell_size, img_w, img_h, layout.x, layout.y, layout.padding, "Errors");
+  DrawText("Red: over", layout.x + layout.width + layout.padding + 10, layout.innerY, 18, UI_TEXT_COLOR);
+  DrawText("Blue: under", layout.x + layout.width + layout.padding + 10, layout.innerY + 20, 18, UI_TEXT_COLOR);
+
+  if (stage >= 4) {
+    next_panel(&layout, 0, gHeight);
+    DrawText("Thank you!", layout.x, layout.y, 36, UI_TEXT_COLOR);
+    DrawText("Powered by raylib", gWidth - 200, gHeight - 30, 20, UI_TEXT_COLOR);
+  }
 
-  Texture2D src_tex = LoadTextureFromImage(img);
+  rlPopMatrix();
+  EndScissorMode();
+  // end zoomable canvas
+}
 
-  Image recon_img = GenImageColor(img_w, img_h, BLACK);
-  Color *recon_px = (Color *)recon_img.data;
-  Texture2D recon_tex = LoadTextureFromImage(recon_img);
+// One frame: input, solver, texture refresh and drawing
+static void app_frame(void *arg) {
+  App *a = (App *)arg;
 
-  Image error_img = GenImageColor(img_w, img_h, BLACK);
-  Color *error_px = (Color *)error_img.data;
-  Texture2D error_tex = LoadTextureFromImage(error_img);
+  ui_handle_input(&a->ui, gWidth);
+  if (IsKeyPressed(KEY_T) && profile_write_trace(PROFILE_TRACE_PATH))
+    download_file(PROFILE_TRACE_PATH);
 
-  SetTargetFPS(60);
+  if (stage >= 2) {
+    app_solve(a, SOLVE_BUDGET_MS);
+
+    // Uploads run at their own, lower rate; the dirty rectangle keeps
+    // growing over the frames in between
+    double now = app_now();
+    ReconRect dirty = RECON_RECT_EMPTY;
+    if (now - a->last_refresh >= 1.0 / TEXTURE_REFRESH_HZ) {
+      a->last_refresh = now;
+      dirty = recon_grid_take_dirty(&a->rgrid);
+    }
+    if (!recon_rect_empty(dirty)) {
+      {
+        PROFILE_ZONE("ui_update_recon_texture");
+        ui_update_recon_texture(a->recon_px, &a->rgrid, dirty);
+      }
+      {
+        PROFILE_ZONE("UpdateTexture");
+        UpdateTextureRec(a->recon_tex, ui_rect_to_texture(dirty), a->recon_px);
+      }
+      {
+        PROFILE_ZONE("ui_update_error_texture");
+        ui_update_error_texture(a->error_px, &a->rgrid, dirty);
+      }
+      {
+        PROFILE_ZONE("UpdateTexture");
+        UpdateTextureRec(a->error_tex, ui_rect_to_texture(dirty), a->error_px);
+      }
+    }
+  }
+
+  {
+    PROFILE_ZONE("draw");
+    app_draw(a);
+  }
+  {
+    // Includes buffer swap and, on desktop, the frame rate limiter's wait
+    PROFILE_ZONE("EndDrawing");
+    EndDrawing();
+  }
+  profile_frame_end();
+}
 
-  size_t curentRayFrame = 0;
+// Upper bound on what app_init reserves in the arena for SOLVER, from the
+// configuration alone: rays, grid, truth and projection scratch, system
+// matrix, the chosen solver's state and the UI buffers
+static size_t app_footprint_bound(int img_w, int img_h, GridLayout layout, bool symmetric) {
+  ArenaBudget b = {sizeof(Arena)};
+  size_t rows = rayset_fan_count(NUM_SOURCES, RAYS_PER_SOURCE);
+  ReconGrid g = recon_grid_shape(img_w, img_h, GRID_CELL_SIZE, layout);
+
+  arena_budget(&b, rows * sizeof(CTRay));
+  arena_budget(&b, rows * sizeof(float));
+  recon_grid_budget(&b, &g);
+  recon_grid_build_truth_budget(&b, img_w);
+  if (SIM_SUB_RAYS <= 0)
+    recon_precompute_projections_budget(&b, &g);
+  if (symmetric)
+    recon_symmatrix_budget(&b, &g, NUM_SOURCES, rows, MATRIX_FORMAT);
+  else
+    recon_matrix_budget(&b, &g, rows, MATRIX_FORMAT);
+
+  if (SOLVER == SOLVER_CGLS || SOLVER == SOLVER_LSQR || SOLVER == SOLVER_OSEM)
+    recon_projector_budget(&b, g.n);
+  if (SOLVER == SOLVER_CGLS)
+    cgls_budget(&b, rows, g.n);
+  if (SOLVER == SOLVER_LSQR)
+    lsqr_budget(&b, rows, g.n);
+  if (SOLVER == SOLVER_OSEM)
+    osem_budget(&b, rows, g.n, NUM_SOURCES, OSEM_SUBSETS);
+  if (SOLVER == SOLVER_SART)
+    recon_sart_budget(&b, &g);
+  if (SOLVER == SOLVER_SIRT) {
+    recon_tiled_budget(&b, &g, rows, 0);
+    recon_sirt_budget(&b, rows, g.n);
+  }
+  if (SOLVER == SOLVER_KACZMARZ_COLORED)
+    recon_coloring_budget(&b, rows, g.n);
+  if (SOLVER == SOLVER_ART_TV)
+    recon_tv_budget(&b, &g);
+  if (SOLVER == SOLVER_MULTIGRID)
+    recon_pyramid_budget(&b, rows, &g, MULTIGRID_LEVELS, MATRIX_FORMAT, img_w, img_h);
+
+  arena_budget(&b, (size_t)g.nx * g.ny);
+  arena_budget(&b, (size_t)g.nx * g.ny * sizeof(Color));
+  arena_budget(&b, rows * 4 * sizeof(float));
+  return b.bytes;
+}
 
-  while (!WindowShouldClose()) {
-    ui_handle_input(&ui, gWidth);
+// Load the slice and build the grid, rays, matrix and solver state.
+// Needs no window, so the headless benchmark shares it.
+static bool app_init(App *a) {
+  unsigned char *originalPixels = NULL;
+  a->img = LoadPGM("./resources/nii_slices/slice_0128.pgm", &originalPixels);
+  if (!a->img.data)
+    return false;
 
-    if (stage >= 2) {
-      // Ensure rays are in reconstruction coordinates before iteration
-      rayset_translate(&rays, 0, 0, img_w, img_h);
+  int img_w = a->img_w = a->img.width;
+  int img_h = a->img_h = a->img.height;
 
-      for (int it = 0; it < ITERATIONS_PER_FRAME; it++) {
-        recon_iterate_fan(&rgrid, &rays, src_idx);
-        src_idx = (src_idx + 1) % NUM_SOURCES;
-        ui.iteration++;
-      }
+  a->ui = ui_state_init();
+  Arena *arena = a->arena = arena_create();
+#ifdef ARENA_TRACE
+  arena_set_trace(arena, arena_trace_log, NULL);
+#endif
 
-      ui_update_recon_texture(recon_px, &rgrid, img_w, img_h);
-      UpdateTexture(recon_tex, recon_px);
+  // The symmetry ops are affine in row-major cell indices only
+  bool symmetric = SYMMETRIC_MATRIX && SOLVER == SOLVER_KACZMARZ;
+  GridLayout layout = symmetric ? GRID_LAYOUT_ROW_MAJOR : GRID_LAYOUT;
+
+  TraceLog(LOG_INFO, "Estimated footprint: at most %zu bytes", app_footprint_bound(img_w, img_h, layout, symmetric));
+  a->rays = rayset_generate_fan(arena, NUM_SOURCES, RAYS_PER_SOURCE, RAYS_SPREAD_ANGLE);
+  a->rgrid = recon_grid_alloc_layout(arena, img_w, img_h, GRID_CELL_SIZE, layout);
+
+  // Rays are placed in reconstruction space once and never moved again;
+  // drawing maps them onto the panel with a view matrix. The fan is centered
+  // on the whole grid, including the partial last cells, so that it is
+  // symmetric to the grid.
+  rayset_translate(&a->rays, 0, 0, a->rgrid.nx * GRID_CELL_SIZE, a->rgrid.ny * GRID_CELL_SIZE);
+  recon_grid_build_truth(arena, &a->rgrid, originalPixels, img_w, img_h);
+  if (SIM_SUB_RAYS > 0)
+    recon_simulate_projections(&a->rays, originalPixels, img_w, img_h, GRID_CELL_SIZE, SIM_SUB_RAYS);
+  else
+    recon_precompute_projections(arena, &a->rgrid, &a->rays);
+  free(originalPixels);
+  recon_add_noise(&a->rays, NOISE);
+  if (symmetric)
+    a->symm = recon_symmatrix_build(arena, &a->rgrid, &a->rays, MATRIX_FORMAT);
+  else
+    a->sysm = recon_matrix_build(arena, &a->rgrid, &a->rays, MATRIX_FORMAT);
+  const ReconMatrix *stored = symmetric ? &a->symm.base : &a->sysm;
+  if (!stored->row_start) {
+    arena_destroy(arena);
+    UnloadImage(a->img);
+    return false;
+  }
+  TraceLog(LOG_INFO, "System matrix: %zu non-zeros, %zu bytes", stored->nnz, recon_matrix_bytes(stored));
+  TraceLog(LOG_INFO, "Accumulation mode: %s", RECON_NUMERICS_NAME);
+
+  // Projector-based solvers: Krylov runs one full iteration per frame, OS-EM one subset
+  if (SOLVER == SOLVER_CGLS || SOLVER == SOLVER_LSQR || SOLVER == SOLVER_OSEM)
+    a->proj = recon_projector_create(arena, &a->sysm, a->rgrid.n);
+  if (SOLVER == SOLVER_CGLS)
+    a->cgls = cgls_init(arena, &a->proj, a->rays.projections, a->rgrid.values);
+  if (SOLVER == SOLVER_LSQR)
+    a->lsqr = lsqr_init(arena, &a->proj, a->rays.projections, a->rgrid.values);
+  if (SOLVER == SOLVER_OSEM)
+    a->osem = osem_init(arena, &a->proj, &a->rays, a->rays.projections, a->rgrid.values, OSEM_SUBSETS);
+
+  if (SOLVER == SOLVER_SART)
+    a->sart = recon_sart_create(arena, &a->rgrid, SART_LAMBDA);
+
+  // SIRT sweeps the whole grid every frame through the tile-binned projector
+  if (SOLVER == SOLVER_SIRT) {
+    a->tiled = recon_tiled_build(arena, &a->sysm, &a->rgrid, 0);
+    a->sirt = recon_sirt_create(arena, &a->tiled, SART_LAMBDA);
+  }
 
-      ui_update_error_texture(error_px, &rgrid, img_w, img_h);
-      UpdateTexture(error_tex, error_px);
-    }
+  // Colored Kaczmarz runs one conflict-free class of rows per step, in parallel
+  if (SOLVER == SOLVER_KACZMARZ_COLORED) {
+    a->coloring = recon_coloring_build(arena, &a->sysm, a->rgrid.n);
+    int parallel = recon_coloring_parallel_colors(&a->coloring, &a->sysm);
+    TraceLog(LOG_INFO, "Row coloring: %d colors, %d with %d+ entries to run in parallel", a->coloring.num_colors, parallel,
+             COLORED_MIN_PARALLEL_ENTRIES);
+    if (parallel == 0)
+      TraceLog(LOG_INFO, "Row coloring: every color is below COLORED_MIN_PARALLEL_ENTRIES on this grid, so it runs single-core");
+  }
 
-    BeginDrawing();
-    ClearBackground(UI_BG_COLOR);
-
-    // start zoomable canvas here
-    BeginScissorMode(0, 0, gWidth, gHeight);
-    rlPushMatrix();
-    if (old_stage != stage) {
-      ui.offset_x = stage_pos[stage].offset_x;
-      ui.offset_y = stage_pos[stage].offset_y;
-      ui.zoom = stage_pos[stage].zoom_level;
-      old_stage = stage;
-    }
-    rlTranslatef(ui.offset_x, ui.offset_y, 0);
-    rlScalef(ui.zoom, ui.zoom, 1.0f);
-
-    // do zoomable graphics here
-
-    UILayout layout = ui_compute_layout(0, 0, img_w, img_h, 0);
-    if (stage >= 0) {
-      const char *label = "Scanning original";
-      switch (stage) {
-      case APP_STAGE_SCAN_GRID:
-        label = "Sample brain scan";
-        break;
-      case APP_STAGE_SCAN_RAYS:
-        label = "Scan grid";
-        break;
-      case APP_STAGE_SCAN_IMAGE:
-        label = "Scanning rays";
-        break;
-      }
-      ui_draw_image_panel(src_tex, layout.x, layout.y, layout.padding, label);
-    }
-    if (stage >= 1) {
-      ui_draw_grid_overlay(layout.innerX, layout.innerY, img_w, img_h, 256 / 5, 256 / 5, 5);
-    }
+  if (SOLVER == SOLVER_ART_TV)
+    a->tv = recon_tv_create(arena, &a->rgrid, TV_STEPS, TV_ALPHA);
 
-    // rays scan
-    if (stage == 2) {
-      rayset_translate(&rays, layout.x, layout.y, layout.width, layout.height);
-      ui_draw_rays(&rays, curentRayFrame);
-      curentRayFrame = (curentRayFrame + 1) % NUM_SOURCES;
-    }
+  // Multigrid runs V-cycles over the coarser copies of the grid, one stage
+  // (a sweep, restriction or correction) per step
+  if (SOLVER == SOLVER_MULTIGRID)
+    a->pyramid = recon_pyramid_build(arena, &a->rays, &a->rgrid, &a->sysm, MULTIGRID_LEVELS, MATRIX_FORMAT, img_w, img_h);
 
-    next_panel(&layout, 0, gHeight);
-    ui_draw_image_panel(recon_tex, layout.x, layout.y, layout.padding, "Kaczmarz Reconstruction");
-    DrawText(TextFormat("Iterations: %d", ui.iteration), layout.x + layout.width + layout.padding + 10, layout.innerY, 18, UI_TEXT_COLOR);
-    DrawText(TextFormat("Num sources: %d", NUM_SOURCES), layout.x + layout.width + layout.padding + 10, layout.innerY + 20, 18, UI_TEXT_COLOR);
-    DrawText(TextFormat("Rays per \n \tsource: %d", RAYS_PER_SOURCE), layout.x + layout.width + layout.padding + 10, layout.innerY + 40, 18, UI_TEXT_COLOR);
+  // One texel per grid cell; the GPU scales them up when drawing
+  a->recon_px = (unsigned char *)arena_alloc_zero(arena, (size_t)a->rgrid.nx * a->rgrid.ny);
+  a->error_px = (Color *)arena_alloc_zero(arena, (size_t)a->rgrid.nx * a->rgrid.ny * sizeof(Color));
+  a->ray_cache = ui_ray_cache_build(arena, &a->rays);
 
-    next_panel(&layout, 0, gHeight);
-    ui_draw_image_panel(error_tex, layout.x, layout.y, layout.padding, "Errors");
-    DrawText("Red: over", layout.x + layout.width + layout.padding + 10, layout.innerY, 18, UI_TEXT_COLOR);
-    DrawText("Blue: under", layout.x + layout.width + layout.padding + 10, layout.innerY + 20, 18, UI_TEXT_COLOR);
-
-    if (stage >= 4) {
-      next_panel(&layout, 0, gHeight);
-      DrawText("Thank you!", layout.x, layout.y, 36, UI_TEXT_COLOR);
-      DrawText("Powered by raylib", gWidth - 200, gHeight - 30, 20, UI_TEXT_COLOR);
+  ArenaStats mem = arena_stats(arena);
+  TraceLog(LOG_INFO, "Arena: %zu bytes requested, %zu reserved, %zu wasted, %zu blocks", mem.requested, mem.reserved,
+           mem.wasted, mem.blocks);
+#ifdef ARENA_STATS
+  TraceLog(LOG_INFO, "Arena: %zu bytes peak, %zu allocations", mem.peak, mem.allocs);
+#endif
+  return true;
+}
+
+static void app_release(App *a) {
+  arena_destroy(a->arena);
+  UnloadImage(a->img);
+}
+
+static double app_rmse(const App *a) {
+  double err = 0.0;
+  for (int i = 0; i < a->rgrid.n; i++) {
+    double d = a->rgrid.values[i] - a->rgrid.ground_truth[i];
+    err += d * d;
+  }
+  return sqrt(err / (a->rgrid.nx * a->rgrid.ny));
+}
+
+// Headless benchmark (`game --bench [frames]`): every solver for `frames`
+// frames, including the CPU side of the texture refresh. No window is
+// opened. This is also the training run of the PGO build (make desktop-pgo).
+// `--bench-realistic` simulates the projections from the full-resolution
+// slice (BENCH_SIM_SUB_RAYS) instead of projecting the ground truth.
+// The RMSE is checked after every frame, and the lowest one is reported with
+// the frame that reached it; a solver whose final RMSE is more than
+// BENCH_RMSE_RISE above that is flagged. The flag is informational:
+// semi-convergence on inconsistent data and fan-to-fan oscillation are
+// normal, and the PGO training run must not fail on them.
+static int app_bench(int frames, int sim_sub_rays) {
+  static const char *names[] = {"kaczmarz", "cgls", "lsqr", "multigrid", "osem", "art-tv", "sart", "sirt", "kaczmarz-c"};
+  SetTraceLogLevel(LOG_WARNING);
+  SIM_SUB_RAYS = sim_sub_rays;
+
+  for (int s = SOLVER_KACZMARZ; s <= SOLVER_KACZMARZ_COLORED; s++) {
+    SOLVER = (ReconSolver)s;
+    App *a = &app;
+    *a = (App){0};
+
+    double t0 = app_now();
+    if (!app_init(a))
+      return 1;
+    double t1 = app_now();
+
+    // Fixed work per frame, so results do not depend on the machine's speed:
+    // a multigrid frame is one whole V-cycle, and colored Kaczmarz steps
+    // color classes until it has run as many rows as the per-fan solvers
+    bool per_fan = SOLVER == SOLVER_KACZMARZ || SOLVER == SOLVER_ART_TV || SOLVER == SOLVER_SART;
+    size_t frame_rows = BENCH_FAN_STEPS * a->rays.metadata.fan.num_rays_per_source;
+    double frame_s = 0.0;
+    double rmse_min = INFINITY;
+    int rmse_min_frame = 0;
+    for (int f = 0; f < frames; f++) {
+      double ft = app_now();
+      if (SOLVER == SOLVER_KACZMARZ_COLORED) {
+        for (size_t rows = 0; rows < frame_rows;) {
+          rows += a->coloring.color_start[a->color + 1] - a->coloring.color_start[a->color];
+          app_step(a);
+        }
+      } else {
+        for (int k = 0; k < (per_fan ? BENCH_FAN_STEPS : 1); k++)
+          app_step(a);
+      }
+      while (SOLVER == SOLVER_MULTIGRID && a->pyramid.stage != 0)
+        app_step(a);
+      ReconRect dirty = recon_grid_take_dirty(&a->rgrid);
+      if (!recon_rect_empty(dirty)) {
+        ui_update_recon_texture(a->recon_px, &a->rgrid, dirty);
+        ui_update_error_texture(a->error_px, &a->rgrid, dirty);
+      }
+      frame_s += app_now() - ft;
+      double rmse = app_rmse(a);
+      if (rmse < rmse_min) {
+        rmse_min = rmse;
+        rmse_min_frame = f + 1;
+      }
     }
 
-    rlPopMatrix();
-    EndScissorMode();
-    // end zoomable canvas
+    double rmse = app_rmse(a);
+    bool rising = rmse > rmse_min * (1.0 + BENCH_RMSE_RISE);
+    printf("%-10s setup %8.2f ms  frame %8.3f ms  rmse %.5f (best %.5f at frame %d)%s\n", names[s], (t1 - t0) * 1e3,
+           frame_s * 1e3 / frames, rmse, rmse_min, rmse_min_frame, rising ? "  RMSE RISING" : "");
+    app_release(a);
+  }
+  profile_write_trace(PROFILE_TRACE_PATH);
+  return 0;
+}
 
-    EndDrawing();
+int main(int argc, char **argv) {
+  profile_init();
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    return app_bench(argc > 2 ? atoi(argv[2]) : 100, SIM_SUB_RAYS);
+  if (argc > 1 && strcmp(argv[1], "--bench-realistic") == 0)
+    return app_bench(argc > 2 ? atoi(argv[2]) : 100, BENCH_SIM_SUB_RAYS);
+
+  SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE);
+  UpdateCanvasInfo();
+  InitWindow(gWidth, gHeight, "Kaczmarz Reconstruction");
+  hide_loader();
+
+  App *a = &app;
+  if (!app_init(a)) {
+    CloseWindow();
+    return 1;
   }
 
-  arena_destroy(arena);
-  UnloadTexture(src_tex);
-  UnloadTexture(recon_tex);
-  UnloadTexture(error_tex);
-  UnloadImage(img);
-  UnloadImage(recon_img);
-  UnloadImage(error_img);
+  a->src_tex = LoadTextureFromImage(a->img);
+  a->recon_tex = ui_load_grid_texture(a->recon_px, &a->rgrid, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+  a->error_tex = ui_load_grid_texture(a->error_px, &a->rgrid, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+#ifdef __EMSCRIPTEN__
+  // The browser calls app_frame on every animation frame; no blocking loop,
+  // so the build does not need ASYNCIFY
+  emscripten_set_main_loop_arg(app_frame, a, 0, true);
+#else
+  SetTargetFPS(60);
+  while (!WindowShouldClose())
+    app_frame(a);
+
+  UnloadTexture(a->src_tex);
+  UnloadTexture(a->recon_tex);
+  UnloadTexture(a->error_tex);
+  app_release(a);
   CloseWindow();
+  profile_write_trace(PROFILE_TRACE_PATH);
+#endif
 
   return 0;
 }
@@ -0,0 +1,369 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "numerics.h"
+#include "ray.h"
+#include <stdint.h>
+
+#if defined(__F16C__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// Weight storage of the compressed system matrix
+typedef enum {
+  MATRIX_F32 = 0, // 4 bytes per weight
+  MATRIX_F16,     // IEEE half, 2 bytes per weight
+  MATRIX_Q8,      // 8-bit fixed point with a per-row scale
+} MatrixFormat;
+
+// Entries decoded per step by the row kernels
+#define MATRIX_BLOCK 8
+
+// Compressed sparse system matrix, one row per ray.
+// Column indices are stored as 16-bit deltas from the previous entry of the
+// row (rows are sorted), with the first column of every row kept in col0.
+typedef struct {
+  MatrixFormat format;
+  size_t rows;
+  size_t nnz;
+  uint32_t *row_start; // rows + 1 offsets into col_delta / weights
+  uint32_t *col0;      // First column of each row
+  uint16_t *col_delta; // Column delta per entry, 0 for the first entry of a row
+  void *weights;       // float, half or uint8_t per entry, padded by MATRIX_BLOCK
+  float *row_scale;    // Q8 dequantization scale per row
+  float *row_norm2;    // Squared norm of each decoded row
+  ReconRect *row_rect; // Bounding rectangle of each row's cells
+} ReconMatrix;
+
+static inline uint16_t matrix_f32_to_f16(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  int32_t exp = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+  uint32_t mant = x & 0x7fffff;
+
+  if (exp <= 0) {
+    // Subnormal half (or flush to zero)
+    if (exp < -10)
+      return (uint16_t)sign;
+    mant |= 0x800000;
+    uint32_t shift = (uint32_t)(14 - exp);
+    uint32_t h = mant >> shift;
+    if ((mant >> (shift - 1)) & 1)
+      h++;
+    return (uint16_t)(sign | h);
+  }
+  if (exp >= 31)
+    return (uint16_t)(sign | 0x7c00);
+
+  // Rounding may carry into the exponent, which is still the correct result
+  uint32_t h = sign | ((uint32_t)exp << 10) | (mant >> 13);
+  if (mant & 0x1000)
+    h++;
+  return (uint16_t)h;
+}
+
+static inline float matrix_f16_to_f32(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+
+  if (exp == 0) {
+    float f = (float)mant * (1.0f / 16777216.0f);
+    return sign ? -f : f;
+  }
+
+  uint32_t x = exp == 31 ? (sign | 0x7f800000 | (mant << 13))
+                         : (sign | ((exp + 112) << 23) | (mant << 13));
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+// Expand MATRIX_BLOCK weights starting at entry k into floats
+static inline void matrix_decode_weights(const ReconMatrix *m, uint32_t k, float scale, float *w) {
+  switch (m->format) {
+  case MATRIX_F32:
+    memcpy(w, (const float *)m->weights + k, MATRIX_BLOCK * sizeof(float));
+    break;
+  case MATRIX_F16: {
+    const uint16_t *src = (const uint16_t *)m->weights + k;
+#if defined(__F16C__)
+    _mm256_storeu_ps(w, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)src)));
+#elif defined(__wasm_simd128__)
+    // Shift the magnitude into float position and rebias by 2^112; this also
+    // covers subnormal halves. Weights are finite, so inf/NaN are not handled.
+    for (int i = 0; i < MATRIX_BLOCK; i += 4) {
+      v128_t h = wasm_u32x4_load16x4(src + i);
+      v128_t mag = wasm_i32x4_shl(wasm_v128_and(h, wasm_i32x4_splat(0x7fff)), 13);
+      v128_t sign = wasm_i32x4_shl(wasm_v128_and(h, wasm_i32x4_splat(0x8000)), 16);
+      wasm_v128_store(w + i, wasm_v128_or(wasm_f32x4_mul(mag, wasm_f32x4_splat(0x1p112f)), sign));
+    }
+#else
+    for (int i = 0; i < MATRIX_BLOCK; i++)
+      w[i] = matrix_f16_to_f32(src[i]);
+#endif
+    break;
+  }
+  case MATRIX_Q8: {
+    const uint8_t *src = (const uint8_t *)m->weights + k;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i q16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src), zero);
+    __m128 s = _mm_set1_ps(scale);
+    _mm_storeu_ps(w, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(q16, zero)), s));
+    _mm_storeu_ps(w + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(q16, zero)), s));
+#elif defined(__wasm_simd128__)
+    v128_t q16 = wasm_u16x8_load8x8(src);
+    v128_t s = wasm_f32x4_splat(scale);
+    wasm_v128_store(w, wasm_f32x4_mul(wasm_f32x4_convert_u32x4(wasm_u32x4_extend_low_u16x8(q16)), s));
+    wasm_v128_store(w + 4, wasm_f32x4_mul(wasm_f32x4_convert_u32x4(wasm_u32x4_extend_high_u16x8(q16)), s));
+#else
+    for (int i = 0; i < MATRIX_BLOCK; i++)
+      w[i] = (float)src[i] * scale;
+#endif
+    break;
+  }
+  }
+}
+
+static inline size_t matrix_weight_size(MatrixFormat format) {
+  switch (format) {
+  case MATRIX_F16:
+    return sizeof(uint16_t);
+  case MATRIX_Q8:
+    return sizeof(uint8_t);
+  default:
+    return sizeof(float);
+  }
+}
+
+// Store one sparse row (ascending cols) at entry offset k
+static inline void matrix_encode_row(ReconMatrix *m, size_t r, uint32_t k, const int *cols, const float *weights, int count) {
+  m->col0[r] = count > 0 ? (uint32_t)cols[0] : 0;
+  m->row_rect[r] = RECON_RECT_EMPTY;
+
+  float maxw = 0.0f;
+  for (int i = 0; i < count; i++) {
+    m->col_delta[k + i] = (uint16_t)(i > 0 ? cols[i] - cols[i - 1] : 0);
+    maxw = fmaxf(maxw, weights[i]);
+  }
+
+  float scale = maxw > 0.0f ? maxw / 255.0f : 1.0f;
+  m->row_scale[r] = scale;
+
+  // Norm is taken over the decoded weights so the projection stays exact
+  ReconSum norm2 = recon_sum_zero();
+  for (int i = 0; i < count; i++) {
+    float w = weights[i];
+    switch (m->format) {
+    case MATRIX_F32:
+      ((float *)m->weights)[k + i] = w;
+      break;
+    case MATRIX_F16: {
+      uint16_t h = matrix_f32_to_f16(w);
+      ((uint16_t *)m->weights)[k + i] = h;
+      w = matrix_f16_to_f32(h);
+      break;
+    }
+    case MATRIX_Q8: {
+      uint8_t q = (uint8_t)fminf(roundf(w / scale), 255.0f);
+      ((uint8_t *)m->weights)[k + i] = q;
+      w = (float)q * scale;
+      break;
+    }
+    }
+    recon_sum_add(&norm2, w * w);
+  }
+  m->row_norm2[r] = recon_sum_value(norm2);
+}
+
+// Build the compressed system matrix for every ray of the set.
+// Rays must already be in reconstruction coordinates. Returns a zeroed
+// matrix (row_start == NULL) when the grid is too wide for 16-bit deltas.
+static inline ReconMatrix recon_matrix_build(Arena *arena, const ReconGrid *g, const RaySet *rs, MatrixFormat format) {
+  ReconMatrix m = {0};
+  m.format = format;
+  m.rows = rs->count;
+
+  // Consecutive entries of a sorted row are at most about two grid rows (or
+  // two block rows) apart
+  int max_gap = g->layout == GRID_LAYOUT_BLOCKED ? 2 * g->blocks_x * GRID_BLOCK * GRID_BLOCK : 2 * g->nx + 2;
+  if (max_gap > UINT16_MAX) {
+    TraceLog(LOG_ERROR, "Grid too wide for 16-bit column deltas: %d", g->nx);
+    return (ReconMatrix){0};
+  }
+
+  int max_row = g->nx + g->ny;
+  m.row_start = (uint32_t *)arena_alloc(arena, (m.rows + 1) * sizeof(uint32_t));
+  m.col0 = (uint32_t *)arena_alloc(arena, m.rows * sizeof(uint32_t));
+  m.row_scale = (float *)arena_alloc(arena, m.rows * sizeof(float));
+  m.row_norm2 = (float *)arena_alloc(arena, m.rows * sizeof(float));
+  m.row_rect = (ReconRect *)arena_alloc(arena, m.rows * sizeof(ReconRect));
+
+  // First pass only counts entries; the scratch row is released afterwards
+  ArenaMark mark = arena_mark(arena);
+  int *cols = (int *)arena_alloc(arena, max_row * sizeof(int));
+  float *weights = (float *)arena_alloc(arena, max_row * sizeof(float));
+
+  m.row_start[0] = 0;
+  for (size_t r = 0; r < m.rows; r++) {
+    int count = recon_build_row_sparse(g, &rs->rays[r], cols, weights);
+    m.row_start[r + 1] = m.row_start[r] + (uint32_t)count;
+  }
+  m.nnz = m.row_start[m.rows];
+  arena_rewind(arena, mark);
+
+  m.col_delta = (uint16_t *)arena_alloc_zero(arena, (m.nnz + MATRIX_BLOCK) * sizeof(uint16_t));
+  m.weights = arena_alloc_zero(arena, (m.nnz + MATRIX_BLOCK) * matrix_weight_size(format));
+
+  mark = arena_mark(arena);
+  cols = (int *)arena_alloc(arena, max_row * sizeof(int));
+  weights = (float *)arena_alloc(arena, max_row * sizeof(float));
+  for (size_t r = 0; r < m.rows; r++) {
+    int count = recon_build_row_sparse(g, &rs->rays[r], cols, weights);
+    matrix_encode_row(&m, r, m.row_start[r], cols, weights, count);
+    for (int i = 0; i < count; i++) {
+      int ix, iy;
+      recon_grid_coords(g, cols[i], &ix, &iy);
+      m.row_rect[r] = recon_rect_union(m.row_rect[r], (ReconRect){ix, iy, ix + 1, iy + 1});
+    }
+  }
+  arena_rewind(arena, mark);
+
+  return m;
+}
+
+// Bytes taken by the matrix arrays
+static inline size_t recon_matrix_bytes(const ReconMatrix *m) {
+  return (m->rows + 1) * sizeof(uint32_t) + m->rows * (sizeof(uint32_t) + 2 * sizeof(float) + sizeof(ReconRect)) +
+         (m->nnz + MATRIX_BLOCK) * (sizeof(uint16_t) + matrix_weight_size(m->format));
+}
+
+// What recon_matrix_build allocates for `rows` rays, before the rays exist:
+// no row crosses more than nx + ny cells
+static inline void recon_matrix_budget(ArenaBudget *b, const ReconGrid *g, size_t rows, MatrixFormat format) {
+  size_t max_row = (size_t)(g->nx + g->ny);
+  size_t nnz = rows * max_row;
+  arena_budget(b, (rows + 1) * sizeof(uint32_t));
+  arena_budget(b, rows * sizeof(uint32_t));
+  arena_budget(b, rows * sizeof(float));
+  arena_budget(b, rows * sizeof(float));
+  arena_budget(b, rows * sizeof(ReconRect));
+  for (int pass = 0; pass < 2; pass++) {
+    arena_budget(b, max_row * sizeof(int));
+    arena_budget(b, max_row * sizeof(float));
+  }
+  arena_budget(b, (nnz + MATRIX_BLOCK) * sizeof(uint16_t));
+  arena_budget(b, (nnz + MATRIX_BLOCK) * matrix_weight_size(format));
+}
+
+// Walks one row a block at a time: every step decodes up to MATRIX_BLOCK
+// column indices and weights.
+//
+//   MatrixRowCursor c = matrix_row_cursor(m, r);
+//   for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));)
+//     for (uint32_t i = 0; i < len; i++) ... cols[i], w[i] ...
+typedef struct {
+  uint32_t k, end; // Next entry, end of the row
+  uint32_t col;    // Column of the last decoded entry
+  float scale;
+} MatrixRowCursor;
+
+static inline MatrixRowCursor matrix_row_cursor(const ReconMatrix *m, size_t r) {
+  return (MatrixRowCursor){m->row_start[r], m->row_start[r + 1], m->col0[r], m->row_scale[r]};
+}
+
+// Decode the next block into cols / w, returns its length, 0 at the row end
+static inline uint32_t matrix_row_next(const ReconMatrix *m, MatrixRowCursor *c, uint32_t cols[MATRIX_BLOCK],
+                                       float w[MATRIX_BLOCK]) {
+  if (c->k >= c->end)
+    return 0;
+  matrix_decode_weights(m, c->k, c->scale, w);
+  uint32_t len = c->end - c->k < MATRIX_BLOCK ? c->end - c->k : MATRIX_BLOCK;
+  for (uint32_t i = 0; i < len; i++) {
+    c->col += m->col_delta[c->k + i];
+    cols[i] = c->col;
+  }
+  c->k += MATRIX_BLOCK;
+  return len;
+}
+
+// <a_r, x>, decoding the row on the fly
+static inline float recon_matrix_row_dot(const ReconMatrix *m, size_t r, const float *x) {
+  MatrixRowCursor c = matrix_row_cursor(m, r);
+  uint32_t cols[MATRIX_BLOCK];
+  float w[MATRIX_BLOCK];
+  ReconSum sum = recon_sum_zero();
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));)
+    for (uint32_t i = 0; i < len; i++)
+      recon_sum_add(&sum, w[i] * x[cols[i]]);
+  return recon_sum_value(sum);
+}
+
+// x += alpha * a_r, decoding the row on the fly
+static inline void recon_matrix_row_axpy(const ReconMatrix *m, size_t r, float alpha, float *x) {
+  MatrixRowCursor c = matrix_row_cursor(m, r);
+  uint32_t cols[MATRIX_BLOCK];
+  float w[MATRIX_BLOCK];
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));)
+    for (uint32_t i = 0; i < len; i++)
+      x[cols[i]] += alpha * w[i];
+}
+
+// x = clamp(x + alpha * a_r, lo, hi) on the row's cells. Clamping in the
+// same pass as the update saves a separate sweep over the grid.
+static inline void recon_matrix_row_axpy_clamp(const ReconMatrix *m, size_t r, float alpha, float *x, ReconBounds bounds) {
+  MatrixRowCursor c = matrix_row_cursor(m, r);
+  uint32_t cols[MATRIX_BLOCK];
+  float w[MATRIX_BLOCK];
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));)
+    for (uint32_t i = 0; i < len; i++)
+      x[cols[i]] = recon_clamp(x[cols[i]] + alpha * w[i], bounds);
+}
+
+// Kaczmarz step on a stored row
+static inline void recon_matrix_kaczmarz_row(const ReconMatrix *m, size_t r, float *x, float projection) {
+  float norm_a = m->row_norm2[r];
+  if (norm_a < 1e-12f)
+    return;
+
+  float alpha = (projection - recon_matrix_row_dot(m, r, x)) / norm_a;
+  recon_matrix_row_axpy(m, r, alpha, x);
+}
+
+// Kaczmarz step followed by projection onto [lo, hi] (POCS)
+static inline void recon_matrix_kaczmarz_row_clamp(const ReconMatrix *m, size_t r, float *x, float projection, ReconBounds bounds) {
+  float norm_a = m->row_norm2[r];
+  if (norm_a < 1e-12f)
+    return;
+
+  float alpha = (projection - recon_matrix_row_dot(m, r, x)) / norm_a;
+  recon_matrix_row_axpy_clamp(m, r, alpha, x, bounds);
+}
+
+// Run one iteration over all rays from a fan source using the stored matrix
+static inline void recon_matrix_iterate_fan(const ReconMatrix *m, ReconGrid *g, const RaySet *rs, size_t iteration) {
+  size_t begin, end;
+  if (!rayset_fan_rows(rs, iteration, &begin, &end))
+    return;
+  for (size_t i = begin; i < end; i++) {
+    recon_matrix_kaczmarz_row(m, i, g->values, rs->projections[i]);
+    recon_grid_touch(g, m->row_rect[i]);
+  }
+}
+
+// Constrained variant of recon_matrix_iterate_fan
+static inline void recon_matrix_iterate_fan_clamp(const ReconMatrix *m, ReconGrid *g, const RaySet *rs, size_t iteration,
+                                                  ReconBounds bounds) {
+  size_t begin, end;
+  if (!rayset_fan_rows(rs, iteration, &begin, &end))
+    return;
+  for (size_t i = begin; i < end; i++) {
+    recon_matrix_kaczmarz_row_clamp(m, i, g->values, rs->projections[i], bounds);
+    recon_grid_touch(g, m->row_rect[i]);
+  }
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "matrix.h"
+#include "numerics.h"
+#include "projector.h"
+#include "ray.h"
+
+// Coarse-to-fine reconstruction pyramid.
+//
+// Level 0 is the full resolution grid; each further level doubles the cell
+// size. All levels are built from the same RaySet, so a residual in
+// projection space is valid on every level as-is and "restricting" it is the
+// identity. Kaczmarz removes high-frequency error quickly on each level while
+// the coarse levels take care of the low frequencies.
+//
+// The coarse operator is not the fine one restricted (a coarse cell is a box,
+// the prolongation is bilinear), and with inconsistent data the coarse solve
+// also fits noise, so the prolongated correction is only a search direction:
+// it is scaled by the step that minimizes the fine residual ||b - A x|| along
+// it. A correction can then never increase the residual, and a poor one is
+// damped to nearly nothing instead of being added in full on every cycle.
+
+#define MULTIGRID_MAX_LEVELS 6
+
+typedef struct {
+  int num_levels;
+  ReconGrid grids[MULTIGRID_MAX_LEVELS];
+  ReconMatrix matrices[MULTIGRID_MAX_LEVELS];
+  float *rhs[MULTIGRID_MAX_LEVELS]; // Right-hand side per level (rays)
+  float *correction;                // Prolongated correction (fine cells)
+  float *ad;                        // A times the correction (rays)
+  const RaySet *rs;
+  int coarse_sweeps; // Kaczmarz sweeps on the coarsest level per cycle
+  int stage;         // Next stage of the current V-cycle
+} ReconPyramid;
+
+// Build the coarser levels below an existing fine grid and matrix.
+// Levels stop early once a grid would be smaller than 8 cells across.
+static inline ReconPyramid recon_pyramid_build(Arena *arena, const RaySet *rs, ReconGrid *fine, const ReconMatrix *fine_m,
+                                               int num_levels, MatrixFormat format, int img_w, int img_h) {
+  ReconPyramid p = {0};
+  p.rs = rs;
+  p.coarse_sweeps = 4;
+  p.grids[0] = *fine;
+  p.matrices[0] = *fine_m;
+  p.rhs[0] = rs->projections;
+  p.num_levels = 1;
+
+  if (num_levels > MULTIGRID_MAX_LEVELS)
+    num_levels = MULTIGRID_MAX_LEVELS;
+  p.correction = (float *)arena_alloc(arena, fine->n * sizeof(float));
+  p.ad = (float *)arena_alloc(arena, rs->count * sizeof(float));
+
+  for (int l = 1; l < num_levels; l++) {
+    int cell_size = fine->cell_size << l;
+    if ((img_w + cell_size - 1) / cell_size < 8 || (img_h + cell_size - 1) / cell_size < 8)
+      break;
+    p.grids[l] = recon_grid_alloc_layout(arena, img_w, img_h, cell_size, fine->layout);
+    p.matrices[l] = recon_matrix_build(arena, &p.grids[l], rs, format);
+    p.rhs[l] = (float *)arena_alloc(arena, rs->count * sizeof(float));
+    p.num_levels++;
+  }
+  return p;
+}
+
+static inline void recon_pyramid_budget(ArenaBudget *b, size_t rows, const ReconGrid *fine, int num_levels,
+                                        MatrixFormat format, int img_w, int img_h) {
+  if (num_levels > MULTIGRID_MAX_LEVELS)
+    num_levels = MULTIGRID_MAX_LEVELS;
+  arena_budget(b, fine->n * sizeof(float));
+  arena_budget(b, rows * sizeof(float));
+  for (int l = 1; l < num_levels; l++) {
+    int cell_size = fine->cell_size << l;
+    if ((img_w + cell_size - 1) / cell_size < 8 || (img_h + cell_size - 1) / cell_size < 8)
+      break;
+    ReconGrid g = recon_grid_shape(img_w, img_h, cell_size, fine->layout);
+    recon_grid_budget(b, &g);
+    recon_matrix_budget(b, &g, rows, format);
+    arena_budget(b, rows * sizeof(float));
+  }
+}
+
+// One Kaczmarz sweep over every ray, in source order
+static inline void pyramid_sweep(const ReconMatrix *m, float *x, const float *b, ReconBounds bounds) {
+  for (size_t r = 0; r < m->rows; r++)
+    recon_matrix_kaczmarz_row_clamp(m, r, x, b[r], bounds);
+}
+
+// y = A x over the worker pool; the forward projection needs no partial images
+static inline void pyramid_forward(const ReconMatrix *m, const float *x, float *y) {
+  ReconProjector fwd = {.m = m};
+  recon_project_forward(&fwd, x, y);
+}
+
+// fine += ratio * bilinear(coarse), ratio = fine / coarse cell size.
+// Weights are normalized by cell size, so the same line integral gives
+// values 1 / ratio times larger on the coarse grid; the factor undoes that.
+static inline void pyramid_prolongate_add(const ReconGrid *coarse, const float *xc, const ReconGrid *fine, float *xf) {
+  float ratio = (float)fine->cell_size / (float)coarse->cell_size;
+
+  for (int iy = 0; iy < fine->ny; iy++) {
+    float v = ((float)iy + 0.5f) * ratio - 0.5f;
+    int y0 = (int)floorf(v);
+    float fy = v - (float)y0;
+    int y1 = y0 + 1;
+    if (y0 < 0)
+      y0 = 0;
+    if (y1 > coarse->ny - 1)
+      y1 = coarse->ny - 1;
+    if (y0 > coarse->ny - 1)
+      y0 = coarse->ny - 1;
+
+    for (int ix = 0; ix < fine->nx; ix++) {
+      float u = ((float)ix + 0.5f) * ratio - 0.5f;
+      int x0 = (int)floorf(u);
+      float fx = u - (float)x0;
+      int x1 = x0 + 1;
+      if (x0 < 0)
+        x0 = 0;
+      if (x1 > coarse->nx - 1)
+        x1 = coarse->nx - 1;
+      if (x0 > coarse->nx - 1)
+        x0 = coarse->nx - 1;
+
+      float top = xc[recon_grid_index(coarse, x0, y0)] * (1.0f - fx) + xc[recon_grid_index(coarse, x1, y0)] * fx;
+      float bottom = xc[recon_grid_index(coarse, x0, y1)] * (1.0f - fx) + xc[recon_grid_index(coarse, x1, y1)] * fx;
+      xf[recon_grid_index(fine, ix, iy)] += ratio * (top * (1.0f - fy) + bottom * fy);
+    }
+  }
+}
+
+// Full multigrid start: solve the coarsest level, then prolongate and
+// refine level by level. Overwrites the fine grid values.
+static inline void recon_pyramid_coarse_to_fine(ReconPyramid *p, int sweeps_per_level) {
+  int coarsest = p->num_levels - 1;
+  for (int l = 0; l < p->num_levels; l++)
+    memset(p->grids[l].values, 0, p->grids[l].n * sizeof(float));
+
+  for (int s = 0; s < p->coarse_sweeps; s++)
+    pyramid_sweep(&p->matrices[coarsest], p->grids[coarsest].values, p->rs->projections, RECON_UNBOUNDED);
+
+  for (int l = coarsest - 1; l >= 0; l--) {
+    pyramid_prolongate_add(&p->grids[l + 1], p->grids[l + 1].values, &p->grids[l], p->grids[l].values);
+    for (int s = 0; s < sweeps_per_level; s++)
+      pyramid_sweep(&p->matrices[l], p->grids[l].values, p->rs->projections, RECON_UNBOUNDED);
+  }
+}
+
+// x_l += t * d, d the prolongated coarse solution, t = <r, A d> / |A d|^2
+// the exact line search on |r - t A d|, r = rhs[l + 1] the residual at
+// restriction. t is kept in [0, 1]: never against the coarse solve, never
+// beyond it. The sum is then clamped to bounds.
+static inline void pyramid_correct(ReconPyramid *p, int l, ReconBounds bounds) {
+  const ReconGrid *g = &p->grids[l];
+  const ReconMatrix *m = &p->matrices[l];
+  const float *r = p->rhs[l + 1];
+  float *d = p->correction;
+
+  memset(d, 0, g->n * sizeof(float));
+  pyramid_prolongate_add(&p->grids[l + 1], p->grids[l + 1].values, g, d);
+  pyramid_forward(m, d, p->ad);
+
+  ReconSum rad = recon_sum_zero(), adad = recon_sum_zero();
+  for (size_t i = 0; i < m->rows; i++) {
+    recon_sum_add(&rad, r[i] * p->ad[i]);
+    recon_sum_add(&adad, p->ad[i] * p->ad[i]);
+  }
+  float den = recon_sum_value(adad);
+  if (den <= 0.0f)
+    return;
+  float t = recon_sum_value(rad) / den;
+  t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+  for (int i = 0; i < g->n; i++)
+    g->values[i] = recon_clamp(g->values[i] + t * d[i], bounds);
+}
+
+// r_{l+1} = b_l - A_l x_l, the right-hand side of the next level, which
+// starts from zero
+static inline void pyramid_restrict(ReconPyramid *p, int l) {
+  const ReconMatrix *m = &p->matrices[l];
+  float *r = p->rhs[l + 1];
+  pyramid_forward(m, p->grids[l].values, r);
+  for (size_t i = 0; i < m->rows; i++)
+    r[i] = p->rhs[l][i] - r[i];
+  memset(p->grids[l + 1].values, 0, p->grids[l + 1].n * sizeof(float));
+}
+
+// A V-cycle as a sequence of stages: on the way down `pre` smoothing sweeps
+// and a restriction per level, coarse_sweeps on the coarsest level, and on the
+// way up a correction and `post` sweeps per level.
+typedef enum {
+  PYRAMID_SMOOTH,
+  PYRAMID_RESTRICT,
+  PYRAMID_CORRECT,
+  PYRAMID_DONE,
+} PyramidStage;
+
+// Kind and level of stage i of the cycle
+static inline PyramidStage pyramid_stage(const ReconPyramid *p, int pre, int post, int i, int *level) {
+  int coarsest = p->num_levels - 1;
+  for (int l = 0; l < coarsest; l++, i -= pre + 1) {
+    *level = l;
+    if (i < pre)
+      return PYRAMID_SMOOTH;
+    if (i == pre)
+      return PYRAMID_RESTRICT;
+  }
+  *level = coarsest;
+  if (i < p->coarse_sweeps)
+    return PYRAMID_SMOOTH;
+  i -= p->coarse_sweeps;
+  for (int l = coarsest - 1; l >= 0; l--, i -= post + 1) {
+    *level = l;
+    if (i == 0)
+      return PYRAMID_CORRECT;
+    if (i <= post)
+      return PYRAMID_SMOOTH;
+  }
+  return PYRAMID_DONE;
+}
+
+// Run the next stage of the current V-cycle on the fine grid, so that a cycle
+// can be spread over several frames. Sweeps on the fine level keep its values
+// within bounds; the coarse levels hold corrections and are not clamped.
+// Returns true when the stage completed a cycle.
+static inline bool recon_pyramid_vcycle_step(ReconPyramid *p, int pre, int post, ReconBounds bounds) {
+  int l;
+  switch (pyramid_stage(p, pre, post, p->stage, &l)) {
+  case PYRAMID_SMOOTH:
+    pyramid_sweep(&p->matrices[l], p->grids[l].values, p->rhs[l], l == 0 ? bounds : RECON_UNBOUNDED);
+    break;
+  case PYRAMID_RESTRICT:
+    pyramid_restrict(p, l);
+    break;
+  case PYRAMID_CORRECT:
+    pyramid_correct(p, l, l == 0 ? bounds : RECON_UNBOUNDED);
+    break;
+  case PYRAMID_DONE:
+    break;
+  }
+
+  p->stage++;
+  if (pyramid_stage(p, pre, post, p->stage, &l) != PYRAMID_DONE)
+    return false;
+  p->stage = 0;
+  return true;
+}
+
+// One whole V-cycle on the fine grid, continuing from its current values
+static inline void recon_pyramid_vcycle(ReconPyramid *p, int pre, int post, ReconBounds bounds) {
+  while (!recon_pyramid_vcycle_step(p, pre, post, bounds)) {
+  }
+}
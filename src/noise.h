@@ -0,0 +1,173 @@
+#pragma once
+
+#include "parallel.h"
+#include "ray.h"
+#include <math.h>
+#include <stdint.h>
+
+// Measurement noise on simulated projections.
+//
+// A projection b is treated as the optical depth along the ray (times
+// `scale`). The detector then counts
+//   N ~ Poisson(i0 * exp(-scale * b)) + Normal(0, electronic^2)
+// photons, and the noisy projection is the log transform -log(N / i0) / scale.
+// Counts below one are clamped to one before the log, like a real
+// preprocessing chain.
+//
+// Random numbers come from Philox4x32-10 (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3", SC'11), keyed by the seed, with the ray index
+// in the counter. Every ray has its own stream, so the result is
+// bit-reproducible for any thread count and any split of the rays.
+
+typedef struct {
+  float i0;         // Incident photons per ray
+  float electronic; // Std. dev. of the additive electronic noise, in counts
+  float scale;      // Optical depth per projection unit
+  uint64_t seed;
+} ReconNoise;
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// Philox4x32 with 10 rounds: four random words per (counter, key)
+static inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; round++) {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    c0 = n0;
+    c2 = n2;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+// Uniform stream of one ray: counter = (ray, block), four words per block
+typedef struct {
+  uint32_t counter[4];
+  uint32_t key[2];
+  uint32_t words[4];
+  int next;
+} NoiseStream;
+
+static inline NoiseStream noise_stream(uint64_t seed, uint64_t ray) {
+  NoiseStream s = {{(uint32_t)ray, (uint32_t)(ray >> 32), 0, 0}, {(uint32_t)seed, (uint32_t)(seed >> 32)}};
+  s.next = 4;
+  return s;
+}
+
+// Uniform in (0, 1), never exactly 0 or 1
+static inline double noise_uniform(NoiseStream *s) {
+  if (s->next == 4) {
+    philox4x32(s->counter, s->key, s->words);
+    s->counter[2]++;
+    s->next = 0;
+  }
+  return ((double)s->words[s->next++] + 0.5) * 0x1p-32;
+}
+
+// Standard normal (Box-Muller, one of the pair)
+static inline double noise_normal(NoiseStream *s) {
+  double u = noise_uniform(s);
+  double v = noise_uniform(s);
+  return sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+// log(k!) for integral k >= 0. Small k from a table, the rest from
+// Stirling's series in n = k + 1, accurate to about 1e-13 there. Pure,
+// unlike lgamma, which writes the global signgam and races across threads.
+static inline double noise_log_factorial(double k) {
+  static const double table[10] = {
+      0.0,
+      0.0,
+      0.69314718055994531,
+      1.79175946922805500,
+      3.17805383034794562,
+      4.78749174278204599,
+      6.57925121201010100,
+      8.52516136106541430,
+      10.60460290274525023,
+      12.80182748008146961,
+  };
+  if (k < 10.0)
+    return table[(int)k];
+  double n = k + 1.0;
+  double inv = 1.0 / n;
+  double inv2 = inv * inv;
+  return (n - 0.5) * log(n) - n + 0.91893853320467274 + inv * (1.0 / 12.0 - inv2 * (1.0 / 360.0 - inv2 / 1260.0));
+}
+
+// Poisson sample: multiplication method for small means, transformed
+// rejection with squeeze (Hoermann's PTRS) for large ones
+static inline double noise_poisson(NoiseStream *s, double lambda) {
+  if (lambda <= 0.0)
+    return 0.0;
+  if (lambda < 10.0) {
+    double limit = exp(-lambda);
+    double prod = noise_uniform(s);
+    double k = 0.0;
+    while (prod > limit) {
+      prod *= noise_uniform(s);
+      k += 1.0;
+    }
+    return k;
+  }
+
+  double slam = sqrt(lambda);
+  double loglam = log(lambda);
+  double b = 0.931 + 2.53 * slam;
+  double a = -0.059 + 0.02483 * b;
+  double inv_alpha = 1.1239 + 1.1328 / (b - 3.4);
+  double vr = 0.9277 - 3.6224 / (b - 2.0);
+  for (;;) {
+    double u = noise_uniform(s) - 0.5;
+    double v = noise_uniform(s);
+    double us = 0.5 - fabs(u);
+    double k = floor((2.0 * a / us + b) * u + lambda + 0.43);
+    if (us >= 0.07 && v <= vr)
+      return k;
+    if (k < 0.0 || (us < 0.013 && v > us))
+      continue;
+    if (log(v) + log(inv_alpha) - log(a / (us * us) + b) <= -lambda + k * loglam - noise_log_factorial(k))
+      return k;
+  }
+}
+
+typedef struct {
+  ReconNoise noise;
+  float *projections;
+} NoiseJob;
+
+static inline void noise_rays(void *ctx, size_t begin, size_t end, int thread) {
+  NoiseJob *job = (NoiseJob *)ctx;
+  ReconNoise n = job->noise;
+  for (size_t r = begin; r < end; r++) {
+    NoiseStream s = noise_stream(n.seed, r);
+    double expected = (double)n.i0 * exp(-(double)n.scale * job->projections[r]);
+    double counts = noise_poisson(&s, expected);
+    if (n.electronic > 0.0f)
+      counts += n.electronic * noise_normal(&s);
+    if (counts < 1.0)
+      counts = 1.0;
+    job->projections[r] = (float)(-log(counts / n.i0) / n.scale);
+  }
+}
+
+// Replace the projections of rs by noisy measurements, multithreaded over rays
+static inline void recon_add_noise(RaySet *rs, ReconNoise noise) {
+  if (noise.i0 <= 0.0f || noise.scale <= 0.0f)
+    return;
+  NoiseJob job = {noise, rs->projections};
+  parallel_for(rs->count, noise_rays, &job);
+}
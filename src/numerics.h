@@ -0,0 +1,63 @@
+#pragma once
+
+// Accumulation mode of the reduction kernels (dot products, projections,
+// row norms), chosen at compile time:
+//   RECON_NUMERICS_FLOAT   plain fp32 running sum (default)
+//   RECON_NUMERICS_DOUBLE  fp64 running sum
+//   RECON_NUMERICS_KAHAN   fp32 with compensated (Neumaier) summation
+// Image, matrix and projection storage stays fp32 in every mode. Only the
+// sums change, so a run can be repeated in a higher mode to tell solver
+// stagnation apart from rounding drift.
+//
+// The Kahan mode relies on strict fp semantics: do not build it with
+// -ffast-math / -fassociative-math, which fold the compensation away.
+
+#include <math.h>
+
+#if defined(RECON_NUMERICS_DOUBLE)
+
+typedef struct {
+  double s;
+} ReconSum;
+
+static inline ReconSum recon_sum_zero(void) { return (ReconSum){0.0}; }
+static inline void recon_sum_add(ReconSum *a, float v) { a->s += (double)v; }
+static inline float recon_sum_value(ReconSum a) { return (float)a.s; }
+
+#define RECON_NUMERICS_NAME "double"
+
+#elif defined(RECON_NUMERICS_KAHAN)
+
+typedef struct {
+  float s, c; // Sum and running compensation
+} ReconSum;
+
+static inline ReconSum recon_sum_zero(void) { return (ReconSum){0.0f, 0.0f}; }
+
+// Neumaier's variant also covers terms larger than the running sum
+static inline void recon_sum_add(ReconSum *a, float v) {
+  float t = a->s + v;
+  if (fabsf(a->s) >= fabsf(v))
+    a->c += (a->s - t) + v;
+  else
+    a->c += (v - t) + a->s;
+  a->s = t;
+}
+
+static inline float recon_sum_value(ReconSum a) { return a.s + a.c; }
+
+#define RECON_NUMERICS_NAME "kahan"
+
+#else
+
+typedef struct {
+  float s;
+} ReconSum;
+
+static inline ReconSum recon_sum_zero(void) { return (ReconSum){0.0f}; }
+static inline void recon_sum_add(ReconSum *a, float v) { a->s += v; }
+static inline float recon_sum_value(ReconSum a) { return a.s; }
+
+#define RECON_NUMERICS_NAME "float"
+
+#endif
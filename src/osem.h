@@ -0,0 +1,121 @@
+#pragma once
+
+#include "arena.h"
+#include "projector.h"
+#include "ray.h"
+
+// Ordered-subsets expectation maximization (OS-EM) for emission-style
+// statistical reconstruction; one subset is plain MLEM.
+//
+// Subsets are groups of whole source fans, interleaved in angle
+// (subset k holds sources k, k + S, k + 2S, ...). Each subset update is
+//   x_j <- x_j / s_j * sum_i a_ij * b_i / (A x)_i,   s = A_S^T 1
+// which is multiplicative, so a positive start stays non-negative.
+
+typedef struct {
+  const ReconProjector *proj;
+  const float *b;
+  float *x;
+  int num_subsets;
+  uint32_t *rows;        // Row ids grouped by subset
+  size_t *subset_start;  // num_subsets + 1 offsets into rows
+  float *sens;           // Sensitivity image per subset (num_subsets * n)
+  float *ratio;          // b / (A x) per ray
+  float *bp;             // Back projected ratio
+  int subset;            // Next subset to apply
+  int iteration;         // Subset updates done
+} OsemSolver;
+
+static inline OsemSolver osem_init(Arena *arena, const ReconProjector *proj, const RaySet *rs, const float *b, float *x,
+                                   int num_subsets) {
+  size_t n = (size_t)proj->n;
+  size_t num_sources = rs->metadata.fan.num_sources;
+  size_t per_source = rs->metadata.fan.num_rays_per_source;
+  if (num_subsets < 1)
+    num_subsets = 1;
+  if ((size_t)num_subsets > num_sources)
+    num_subsets = (int)num_sources;
+
+  OsemSolver o = {.proj = proj, .b = b, .x = x, .num_subsets = num_subsets};
+  o.rows = (uint32_t *)arena_alloc(arena, rs->count * sizeof(uint32_t));
+  o.subset_start = (size_t *)arena_alloc(arena, (num_subsets + 1) * sizeof(size_t));
+  o.sens = (float *)arena_alloc(arena, num_subsets * n * sizeof(float));
+  o.ratio = (float *)arena_alloc_zero(arena, rs->count * sizeof(float));
+  o.bp = (float *)arena_alloc(arena, n * sizeof(float));
+
+  size_t k = 0;
+  for (int s = 0; s < num_subsets; s++) {
+    o.subset_start[s] = k;
+    for (size_t src = s; src < num_sources; src += num_subsets)
+      for (size_t j = 0; j < per_source; j++)
+        o.rows[k++] = (uint32_t)(src * per_source + j);
+  }
+  o.subset_start[num_subsets] = k;
+
+  // Sensitivity images: back projection of ones over each subset
+  for (size_t i = 0; i < rs->count; i++)
+    o.ratio[i] = 1.0f;
+  for (int s = 0; s < num_subsets; s++) {
+    size_t start = o.subset_start[s];
+    recon_project_back_rows(proj, o.rows + start, o.subset_start[s + 1] - start, o.ratio, o.sens + s * n);
+  }
+
+  // Uniform start matching the total measured attenuation. Cells no ray
+  // passes through can never be updated, so they start (and stay) at zero.
+  recon_project_back(proj, o.ratio, o.bp);
+  double total_b = 0.0, total_sens = 0.0;
+  for (size_t i = 0; i < rs->count; i++)
+    total_b += b[i];
+  for (size_t i = 0; i < n; i++)
+    total_sens += o.bp[i];
+  float x0 = total_sens > 0.0 ? (float)(total_b / total_sens) : 1.0f;
+  for (size_t i = 0; i < n; i++)
+    x[i] = o.bp[i] > 0.0f ? x0 : 0.0f;
+
+  return o;
+}
+
+static inline void osem_budget(ArenaBudget *b, size_t rows, int n, size_t num_sources, int num_subsets) {
+  if (num_subsets < 1)
+    num_subsets = 1;
+  if ((size_t)num_subsets > num_sources)
+    num_subsets = (int)num_sources;
+  arena_budget(b, rows * sizeof(uint32_t));
+  arena_budget(b, (num_subsets + 1) * sizeof(size_t));
+  arena_budget(b, (size_t)num_subsets * n * sizeof(float));
+  arena_budget(b, rows * sizeof(float));
+  arena_budget(b, n * sizeof(float));
+}
+
+// Apply the next subset update
+static inline void osem_step(OsemSolver *o) {
+  size_t n = (size_t)o->proj->n;
+  int s = o->subset;
+  size_t start = o->subset_start[s];
+  size_t count = o->subset_start[s + 1] - start;
+  const uint32_t *rows = o->rows + start;
+
+  recon_project_forward_rows(o->proj, rows, count, o->x, o->ratio);
+  for (size_t k = 0; k < count; k++) {
+    uint32_t r = rows[k];
+    float ax = o->ratio[r];
+    // Counts cannot be negative; noisy log data can be, and a negative ratio
+    // would flip the sign of the multiplicative update
+    float b = o->b[r] > 0.0f ? o->b[r] : 0.0f;
+    o->ratio[r] = ax > 1e-12f ? b / ax : 0.0f;
+  }
+  recon_project_back_rows(o->proj, rows, count, o->ratio, o->bp);
+
+  const float *sens = o->sens + s * n;
+  for (size_t i = 0; i < n; i++)
+    o->x[i] = sens[i] > 1e-12f ? o->x[i] * o->bp[i] / sens[i] : o->x[i];
+
+  o->subset = (s + 1) % o->num_subsets;
+  o->iteration++;
+}
+
+// One full pass over all subsets
+static inline void osem_pass(OsemSolver *o) {
+  for (int s = 0; s < o->num_subsets; s++)
+    osem_step(o);
+}
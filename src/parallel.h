@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "profile.h"
+
+// Single-threaded wasm builds have no pthreads; everything runs inline there
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define PARALLEL_SERIAL
+#endif
+
+#ifndef PARALLEL_SERIAL
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define PARALLEL_MAX_THREADS 64
+
+// Work callback: process items [begin, end) as worker `thread`. Every worker
+// is called once per parallel_for, even when its range is empty.
+typedef void (*ParallelFn)(void *ctx, size_t begin, size_t end, int thread);
+
+// Persistent worker pool. Work is split into one contiguous range per thread,
+// so for a fixed thread count the partition (and any per-thread partial
+// result) is deterministic.
+typedef struct {
+  int num_threads;
+#ifndef PARALLEL_SERIAL
+  pthread_t threads[PARALLEL_MAX_THREADS];
+  pthread_mutex_t lock;
+  pthread_cond_t work_cv;
+  pthread_cond_t done_cv;
+  unsigned long generation;
+  int pending;
+  ParallelFn fn;
+  void *ctx;
+  size_t count;
+#endif
+} ParallelPool;
+
+static ParallelPool parallel_pool;
+
+static inline void parallel_range(size_t count, int thread, int num_threads, size_t *begin, size_t *end) {
+  *begin = count * (size_t)thread / (size_t)num_threads;
+  *end = count * (size_t)(thread + 1) / (size_t)num_threads;
+}
+
+#ifndef PARALLEL_SERIAL
+static inline void *parallel_worker(void *arg) {
+  ParallelPool *p = &parallel_pool;
+  int thread = (int)(intptr_t)arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&p->lock);
+  for (;;) {
+    while (p->generation == seen)
+      pthread_cond_wait(&p->work_cv, &p->lock);
+    seen = p->generation;
+    ParallelFn fn = p->fn;
+    void *ctx = p->ctx;
+    size_t count = p->count;
+    pthread_mutex_unlock(&p->lock);
+
+    size_t begin, end;
+    parallel_range(count, thread, p->num_threads, &begin, &end);
+    {
+      PROFILE_ZONE("parallel_for");
+      fn(ctx, begin, end, thread);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if (--p->pending == 0)
+      pthread_cond_signal(&p->done_cv);
+  }
+  return NULL;
+}
+#endif
+
+// Start the pool; 0 threads means one per online CPU
+static inline void parallel_init(int num_threads) {
+  ParallelPool *p = &parallel_pool;
+  if (p->num_threads)
+    return;
+
+#ifdef PARALLEL_SERIAL
+  (void)num_threads;
+  p->num_threads = 1;
+#else
+  if (num_threads <= 0)
+    num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_threads < 1)
+    num_threads = 1;
+  if (num_threads > PARALLEL_MAX_THREADS)
+    num_threads = PARALLEL_MAX_THREADS;
+  p->num_threads = num_threads;
+
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->work_cv, NULL);
+  pthread_cond_init(&p->done_cv, NULL);
+
+  // The calling thread acts as worker 0
+  for (int t = 1; t < num_threads; t++)
+    pthread_create(&p->threads[t], NULL, parallel_worker, (void *)(intptr_t)t);
+#endif
+}
+
+static inline int parallel_num_threads(void) {
+  parallel_init(0);
+  return parallel_pool.num_threads;
+}
+
+// Run fn over [0, count) split across the pool and wait for completion.
+// Not reentrant: only call it from the main thread.
+static inline void parallel_for(size_t count, ParallelFn fn, void *ctx) {
+  ParallelPool *p = &parallel_pool;
+  parallel_init(0);
+
+  if (p->num_threads == 1) {
+    fn(ctx, 0, count, 0);
+    return;
+  }
+
+#ifndef PARALLEL_SERIAL
+  pthread_mutex_lock(&p->lock);
+  p->fn = fn;
+  p->ctx = ctx;
+  p->count = count;
+  p->pending = p->num_threads - 1;
+  p->generation++;
+  pthread_cond_broadcast(&p->work_cv);
+  pthread_mutex_unlock(&p->lock);
+
+  size_t begin, end;
+  parallel_range(count, 0, p->num_threads, &begin, &end);
+  fn(ctx, begin, end, 0);
+
+  pthread_mutex_lock(&p->lock);
+  while (p->pending > 0)
+    pthread_cond_wait(&p->done_cv, &p->lock);
+  pthread_mutex_unlock(&p->lock);
+#endif
+}
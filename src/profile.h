@@ -0,0 +1,197 @@
+#pragma once
+
+// Scoped timing zones for finding where a frame's time goes.
+//
+// Built only with RECON_PROFILE (make PROFILE=1); otherwise every macro below
+// expands to nothing. A zone covers the rest of the enclosing block:
+//
+//   { PROFILE_ZONE("solve"); app_solve(a); }
+//
+// Each thread appends finished zones to its own ring buffer, so recording
+// takes no locks. The rings keep the last PROFILE_RING_EVENTS zones per
+// thread and can be written out as a Chrome trace_event file
+// (chrome://tracing, ui.perfetto.dev). Zones closed on the main thread are
+// also summed per frame for the live HUD (profile_frame_end, profile_hud).
+//
+// Timestamps come from CLOCK_MONOTONIC. On x86 PROFILE_RDTSC reads the
+// time-stamp counter instead, scaled against the monotonic clock since
+// profile_init.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef RECON_PROFILE
+
+#if defined(PROFILE_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILE_USE_TSC
+#endif
+
+#define PROFILE_MAX_THREADS 64
+#define PROFILE_RING_EVENTS (1 << 15)
+#define PROFILE_MAX_ZONES 32
+#define PROFILE_HUD_SMOOTHING 0.1f
+
+typedef struct {
+  const char *name;
+  uint64_t begin, end; // Ticks
+} ProfileEvent;
+
+typedef struct {
+  ProfileEvent *events; // PROFILE_RING_EVENTS, allocated on first use
+  uint64_t head;        // Events written so far
+} ProfileRing;
+
+// Per-frame totals of the main thread's zones
+typedef struct {
+  const char *name;
+  uint64_t frame_ticks;
+  float ms; // Smoothed over frames
+} ProfileZoneStats;
+
+typedef struct {
+  ProfileRing rings[PROFILE_MAX_THREADS];
+  int num_threads;
+  ProfileZoneStats zones[PROFILE_MAX_ZONES];
+  int num_zones;
+  uint64_t tick0, ns0; // Reference point of the tick scale
+} Profiler;
+
+typedef struct {
+  const char *name;
+  uint64_t begin;
+} ProfileZone;
+
+static Profiler profiler;
+static _Thread_local int profile_thread = -1;
+
+static inline uint64_t profile_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t profile_ticks(void) {
+#ifdef PROFILE_USE_TSC
+  return __rdtsc();
+#else
+  return profile_ns();
+#endif
+}
+
+// Nanoseconds per tick, measured over the time since profile_init
+static inline double profile_tick_ns(void) {
+#ifdef PROFILE_USE_TSC
+  uint64_t ticks = profile_ticks() - profiler.tick0;
+  uint64_t ns = profile_ns() - profiler.ns0;
+  return ticks > 0 && ns > 0 ? (double)ns / (double)ticks : 1.0;
+#else
+  return 1.0;
+#endif
+}
+
+// Call first thing on the main thread, which becomes thread 0
+static inline void profile_init(void) {
+  profiler.tick0 = profile_ticks();
+  profiler.ns0 = profile_ns();
+  profile_thread = __atomic_fetch_add(&profiler.num_threads, 1, __ATOMIC_RELAXED);
+}
+
+static inline ProfileRing *profile_ring(void) {
+  if (profile_thread < 0)
+    profile_thread = __atomic_fetch_add(&profiler.num_threads, 1, __ATOMIC_RELAXED);
+  if (profile_thread >= PROFILE_MAX_THREADS)
+    return NULL;
+  ProfileRing *ring = &profiler.rings[profile_thread];
+  if (!ring->events)
+    ring->events = (ProfileEvent *)calloc(PROFILE_RING_EVENTS, sizeof(ProfileEvent));
+  return ring;
+}
+
+static inline ProfileZone profile_zone_begin(const char *name) {
+  return (ProfileZone){name, profile_ticks()};
+}
+
+static inline void profile_zone_end(ProfileZone *zone) {
+  uint64_t end = profile_ticks();
+  ProfileRing *ring = profile_ring();
+  if (!ring || !ring->events)
+    return;
+  ring->events[ring->head % PROFILE_RING_EVENTS] = (ProfileEvent){zone->name, zone->begin, end};
+  ring->head++;
+
+  if (profile_thread != 0)
+    return;
+  int z = 0;
+  while (z < profiler.num_zones && profiler.zones[z].name != zone->name)
+    z++;
+  if (z == profiler.num_zones) {
+    if (z == PROFILE_MAX_ZONES)
+      return;
+    profiler.zones[profiler.num_zones++] = (ProfileZoneStats){zone->name, 0, 0.0f};
+  }
+  profiler.zones[z].frame_ticks += end - zone->begin;
+}
+
+#define PROFILE_CAT2(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT2(a, b)
+#define PROFILE_ZONE(name) \
+  ProfileZone PROFILE_CAT(profile_zone_, __LINE__) __attribute__((cleanup(profile_zone_end))) = profile_zone_begin(name)
+
+// Fold this frame's zone totals into the HUD averages
+static inline void profile_frame_end(void) {
+  double tick_ns = profile_tick_ns();
+  for (int z = 0; z < profiler.num_zones; z++) {
+    ProfileZoneStats *s = &profiler.zones[z];
+    float ms = (float)((double)s->frame_ticks * tick_ns * 1e-6);
+    s->ms += PROFILE_HUD_SMOOTHING * (ms - s->ms);
+    s->frame_ticks = 0;
+  }
+}
+
+// Zone `i` of the HUD, in first-seen order; false past the last one
+static inline bool profile_hud(int i, const char **name, float *ms) {
+  if (i >= profiler.num_zones)
+    return false;
+  *name = profiler.zones[i].name;
+  *ms = profiler.zones[i].ms;
+  return true;
+}
+
+// Write every buffered zone as complete ("X") events. Workers must be idle.
+static inline bool profile_write_trace(const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+  double us = profile_tick_ns() * 1e-3;
+  const char *sep = "";
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (int t = 0; t < profiler.num_threads && t < PROFILE_MAX_THREADS; t++) {
+    const ProfileRing *ring = &profiler.rings[t];
+    if (!ring->events)
+      continue;
+    uint64_t first = ring->head > PROFILE_RING_EVENTS ? ring->head - PROFILE_RING_EVENTS : 0;
+    for (uint64_t i = first; i < ring->head; i++) {
+      const ProfileEvent *e = &ring->events[i % PROFILE_RING_EVENTS];
+      fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", sep, e->name, t,
+              (double)(e->begin - profiler.tick0) * us, (double)(e->end - e->begin) * us);
+      sep = ",";
+    }
+  }
+  fprintf(f, "\n]}\n");
+  return fclose(f) == 0;
+}
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+
+static inline void profile_init(void) {}
+static inline void profile_frame_end(void) {}
+static inline bool profile_hud(int i, const char **name, float *ms) { return false; }
+static inline bool profile_write_trace(const char *path) { return false; }
+
+#endif
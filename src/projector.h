@@ -0,0 +1,93 @@
+#pragma once
+
+#include "arena.h"
+#include "matrix.h"
+#include "parallel.h"
+
+// Forward (A x) and back (A^T y) projection over the stored system matrix,
+// split across the worker pool. The back projection scatters into one
+// partial image per thread and then sums them in a fixed order, so results
+// do not depend on scheduling.
+typedef struct {
+  const ReconMatrix *m;
+  int n;          // Image size (columns of A)
+  int threads;    // Number of partial images
+  float *partial; // threads * n accumulation buffers
+} ReconProjector;
+
+static inline ReconProjector recon_projector_create(Arena *arena, const ReconMatrix *m, int n) {
+  ReconProjector p;
+  p.m = m;
+  p.n = n;
+  p.threads = parallel_num_threads();
+  p.partial = (float *)arena_alloc(arena, (size_t)p.threads * n * sizeof(float));
+  return p;
+}
+
+static inline void recon_projector_budget(ArenaBudget *b, int n) {
+  arena_budget(b, (size_t)parallel_num_threads() * n * sizeof(float));
+}
+
+typedef struct {
+  const ReconProjector *p;
+  const uint32_t *rows; // Row subset, NULL for all rows
+  const float *in;
+  float *out;
+} ProjectorJob;
+
+static inline void projector_forward_range(void *ctx, size_t begin, size_t end, int thread) {
+  ProjectorJob *job = (ProjectorJob *)ctx;
+  for (size_t k = begin; k < end; k++) {
+    size_t r = job->rows ? job->rows[k] : k;
+    job->out[r] = recon_matrix_row_dot(job->p->m, r, job->in);
+  }
+}
+
+static inline void projector_back_range(void *ctx, size_t begin, size_t end, int thread) {
+  ProjectorJob *job = (ProjectorJob *)ctx;
+  float *acc = job->p->partial + (size_t)thread * job->p->n;
+  memset(acc, 0, job->p->n * sizeof(float));
+  for (size_t k = begin; k < end; k++) {
+    size_t r = job->rows ? job->rows[k] : k;
+    if (job->in[r] != 0.0f)
+      recon_matrix_row_axpy(job->p->m, r, job->in[r], acc);
+  }
+}
+
+static inline void projector_reduce_range(void *ctx, size_t begin, size_t end, int thread) {
+  ProjectorJob *job = (ProjectorJob *)ctx;
+  const ReconProjector *p = job->p;
+  for (size_t i = begin; i < end; i++)
+    job->out[i] = p->partial[i];
+  for (int t = 1; t < p->threads; t++) {
+    const float *acc = p->partial + (size_t)t * p->n;
+    for (size_t i = begin; i < end; i++)
+      job->out[i] += acc[i];
+  }
+}
+
+// y = A x (one value per ray)
+static inline void recon_project_forward(const ReconProjector *p, const float *x, float *y) {
+  ProjectorJob job = {p, NULL, x, y};
+  parallel_for(p->m->rows, projector_forward_range, &job);
+}
+
+// x = A^T y (one value per cell)
+static inline void recon_project_back(const ReconProjector *p, const float *y, float *x) {
+  ProjectorJob job = {p, NULL, y, x};
+  parallel_for(p->m->rows, projector_back_range, &job);
+  parallel_for((size_t)p->n, projector_reduce_range, &job);
+}
+
+// y[r] = <a_r, x> for the listed rows only; other entries of y are untouched
+static inline void recon_project_forward_rows(const ReconProjector *p, const uint32_t *rows, size_t count, const float *x, float *y) {
+  ProjectorJob job = {p, rows, x, y};
+  parallel_for(count, projector_forward_range, &job);
+}
+
+// x = A_S^T y restricted to the listed rows S
+static inline void recon_project_back_rows(const ReconProjector *p, const uint32_t *rows, size_t count, const float *y, float *x) {
+  ProjectorJob job = {p, rows, y, x};
+  parallel_for(count, projector_back_range, &job);
+  parallel_for((size_t)p->n, projector_reduce_range, &job);
+}
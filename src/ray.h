@@ -85,6 +85,15 @@ bool rayset_translate(RaySet *rs, int x, int y, int w, int h) {
   return false;
 }
 
+// Rays [begin, end) of fan source `iteration`; false when the set is not a fan
+bool rayset_fan_rows(const RaySet *rs, size_t iteration, size_t *begin, size_t *end) {
+  if (rs->type != RAY_MODE_FAN)
+    return false;
+  *begin = iteration * rs->metadata.fan.num_rays_per_source;
+  *end = *begin + rs->metadata.fan.num_rays_per_source;
+  return true;
+}
+
 // Allocate a ray set
 RaySet rayset_alloc(Arena *arena, size_t count_rays) {
   RaySet rs;
@@ -100,12 +109,17 @@ void rayset_append(RaySet *rs, CTRay ray) {
   rs->count += 1;
 }
 
+// Rays of a fan set; every source gets an odd number of rays, centered on its axis
+size_t rayset_fan_count(size_t num_sources, size_t num_rays_per_source) {
+  return num_sources * (2 * (num_rays_per_source / 2) + 1);
+}
+
 // Generate fan beam ray set
 RaySet rayset_generate_fan(Arena *arena, size_t num_sources, size_t num_rays_per_source, float angle_spread_deg) {
   int halfNumRays = num_rays_per_source / 2;
   size_t actual_rays_per_source = 2 * halfNumRays + 1;
 
-  RaySet rs = rayset_alloc(arena, num_sources * actual_rays_per_source);
+  RaySet rs = rayset_alloc(arena, rayset_fan_count(num_sources, num_rays_per_source));
 
   float radius = 1.0f;
   float angle_spread_rad = angle_spread_deg * PI / 180.0f;
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "matrix.h"
+#include "numerics.h"
+#include "ray.h"
+
+// Simultaneous ART over one source fan at a time:
+//   x_j <- clamp(x_j + lambda * sum_i a_ij r_i / sum_i a_ij, lo, hi),
+//   r_i = (b_i - <a_i, x>) / sum_j a_ij
+// The clamp is applied in the update pass itself.
+typedef struct {
+  float lambda; // Relaxation
+  float *num;   // Back projected normalized residual (n)
+  float *den;   // Column sums of the fan (n)
+  int n;
+} ReconSart;
+
+static inline ReconSart recon_sart_create(Arena *arena, const ReconGrid *g, float lambda) {
+  ReconSart s = {.lambda = lambda, .n = g->n};
+  s.num = (float *)arena_alloc(arena, g->n * sizeof(float));
+  s.den = (float *)arena_alloc(arena, g->n * sizeof(float));
+  return s;
+}
+
+static inline void recon_sart_budget(ArenaBudget *b, const ReconGrid *g) {
+  arena_budget(b, g->n * sizeof(float));
+  arena_budget(b, g->n * sizeof(float));
+}
+
+// Residual of one ray, spread over num / den in a single pass over its row
+static inline void sart_accumulate_row(const ReconMatrix *m, size_t r, const float *x, float projection, float *num, float *den) {
+  uint32_t cols[MATRIX_BLOCK];
+  float w[MATRIX_BLOCK];
+  ReconSum ax_sum = recon_sum_zero(), w_sum = recon_sum_zero();
+
+  MatrixRowCursor c = matrix_row_cursor(m, r);
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));) {
+    for (uint32_t i = 0; i < len; i++) {
+      recon_sum_add(&ax_sum, w[i] * x[cols[i]]);
+      recon_sum_add(&w_sum, w[i]);
+    }
+  }
+  float ax = recon_sum_value(ax_sum);
+  float row_sum = recon_sum_value(w_sum);
+  if (row_sum < 1e-12f)
+    return;
+
+  float res = (projection - ax) / row_sum;
+  c = matrix_row_cursor(m, r);
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));) {
+    for (uint32_t i = 0; i < len; i++) {
+      num[cols[i]] += res * w[i];
+      den[cols[i]] += w[i];
+    }
+  }
+}
+
+// One SART update using all rays of a fan source
+static inline void recon_sart_iterate_fan(const ReconMatrix *m, ReconSart *s, ReconGrid *g, const RaySet *rs, size_t iteration,
+                                          ReconBounds bounds) {
+  size_t begin, end;
+  if (!rayset_fan_rows(rs, iteration, &begin, &end))
+    return;
+  memset(s->num, 0, s->n * sizeof(float));
+  memset(s->den, 0, s->n * sizeof(float));
+
+  for (size_t i = begin; i < end; i++) {
+    sart_accumulate_row(m, i, g->values, rs->projections[i], s->num, s->den);
+    recon_grid_touch(g, m->row_rect[i]);
+  }
+
+  for (int j = 0; j < s->n; j++) {
+    if (s->den[j] > 0.0f)
+      g->values[j] = recon_clamp(g->values[j] + s->lambda * s->num[j] / s->den[j], bounds);
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// Minimal 4-wide float vector used by the stencil and vector kernels.
+// SSE2 on x86, wasm SIMD128 when built with -msimd128, plain structs
+// elsewhere (the compiler is free to vectorize).
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+
+typedef __m128 f32x4;
+
+static inline f32x4 f32x4_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void f32x4_store(float *p, f32x4 v) { _mm_storeu_ps(p, v); }
+static inline f32x4 f32x4_set1(float s) { return _mm_set1_ps(s); }
+static inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+static inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return _mm_sub_ps(a, b); }
+static inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+static inline f32x4 f32x4_div(f32x4 a, f32x4 b) { return _mm_div_ps(a, b); }
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return _mm_min_ps(a, b); }
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return _mm_max_ps(a, b); }
+static inline f32x4 f32x4_sqrt(f32x4 a) { return _mm_sqrt_ps(a); }
+
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+
+typedef v128_t f32x4;
+
+static inline f32x4 f32x4_load(const float *p) { return wasm_v128_load(p); }
+static inline void f32x4_store(float *p, f32x4 v) { wasm_v128_store(p, v); }
+static inline f32x4 f32x4_set1(float s) { return wasm_f32x4_splat(s); }
+static inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return wasm_f32x4_add(a, b); }
+static inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return wasm_f32x4_sub(a, b); }
+static inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return wasm_f32x4_mul(a, b); }
+static inline f32x4 f32x4_div(f32x4 a, f32x4 b) { return wasm_f32x4_div(a, b); }
+// pmin/pmax match the SSE semantics and lower to single instructions
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return wasm_f32x4_pmin(a, b); }
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return wasm_f32x4_pmax(a, b); }
+static inline f32x4 f32x4_sqrt(f32x4 a) { return wasm_f32x4_sqrt(a); }
+
+#else
+#include <math.h>
+
+typedef struct {
+  float v[4];
+} f32x4;
+
+static inline f32x4 f32x4_load(const float *p) { return (f32x4){{p[0], p[1], p[2], p[3]}}; }
+static inline void f32x4_store(float *p, f32x4 a) {
+  p[0] = a.v[0];
+  p[1] = a.v[1];
+  p[2] = a.v[2];
+  p[3] = a.v[3];
+}
+static inline f32x4 f32x4_set1(float s) { return (f32x4){{s, s, s, s}}; }
+
+#define F32X4_BINARY(name, expr)                                                 \
+  static inline f32x4 name(f32x4 a, f32x4 b) {                                   \
+    f32x4 r;                                                                     \
+    for (int i = 0; i < 4; i++)                                                  \
+      r.v[i] = expr;                                                             \
+    return r;                                                                    \
+  }
+F32X4_BINARY(f32x4_add, a.v[i] + b.v[i])
+F32X4_BINARY(f32x4_sub, a.v[i] - b.v[i])
+F32X4_BINARY(f32x4_mul, a.v[i] * b.v[i])
+F32X4_BINARY(f32x4_div, a.v[i] / b.v[i])
+F32X4_BINARY(f32x4_min, fminf(a.v[i], b.v[i]))
+F32X4_BINARY(f32x4_max, fmaxf(a.v[i], b.v[i]))
+#undef F32X4_BINARY
+
+static inline f32x4 f32x4_sqrt(f32x4 a) {
+  for (int i = 0; i < 4; i++)
+    a.v[i] = sqrtf(a.v[i]);
+  return a;
+}
+#endif
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "numerics.h"
+#include "parallel.h"
+#include "ray.h"
+#include "utils.h"
+#include <math.h>
+
+// Forward simulation of the measured projections from the full-resolution
+// slice instead of the downsampled ground-truth grid.
+//
+// Projecting the same grid that is reconstructed (recon_precompute_projections)
+// is the "inverse crime": the data is exactly consistent with the model, so
+// discretization error never shows up in the residual. Here every detector
+// element integrates several sub-rays, spread evenly over its angular width,
+// through the original pixels with a grid walk (Amanatides-Woo). The result is
+// in the units of the grid model, sum of (length / cell_size) * value, so the
+// solvers see the same scale as before.
+
+#define SIMULATE_MAX_SUB_RAYS 16
+
+typedef struct {
+  const RaySet *rs;
+  const unsigned char *pixels;
+  int img_w, img_h;
+  float cell_size;
+  size_t rays_per_view;
+  int sub_rays;
+  float sub_cos[SIMULATE_MAX_SUB_RAYS], sub_sin[SIMULATE_MAX_SUB_RAYS];
+} SimulateJob;
+
+// Line integral of pixel values / 255 along a ray, in pixel lengths
+static inline float simulate_ray(const unsigned char *pixels, int w, int h, float ox, float oy, float dx, float dy) {
+  Rect box = {0.0f, 0.0f, (float)w, (float)h};
+  LiangBarskyResult hit = liang_barsky_ray(&box, ox, oy, dx, dy);
+  if (!hit.intersects || hit.length <= 0.0f)
+    return 0.0f;
+
+  float t = hit.t1;
+  int ix = (int)floorf(ox + dx * t);
+  int iy = (int)floorf(oy + dy * t);
+  ix = ix < 0 ? 0 : ix > w - 1 ? w - 1 : ix;
+  iy = iy < 0 ? 0 : iy > h - 1 ? h - 1 : iy;
+
+  // Ray parameter of the next vertical / horizontal pixel border, and the
+  // parameter step between borders
+  int step_x = dx > 0.0f ? 1 : -1;
+  int step_y = dy > 0.0f ? 1 : -1;
+  float next_x = dx != 0.0f ? ((float)(dx > 0.0f ? ix + 1 : ix) - ox) / dx : INFINITY;
+  float next_y = dy != 0.0f ? ((float)(dy > 0.0f ? iy + 1 : iy) - oy) / dy : INFINITY;
+  float delta_x = dx != 0.0f ? fabsf(1.0f / dx) : INFINITY;
+  float delta_y = dy != 0.0f ? fabsf(1.0f / dy) : INFINITY;
+
+  ReconSum sum = recon_sum_zero();
+  while (t < hit.t2) {
+    float next = next_x < next_y ? next_x : next_y;
+    if (next > hit.t2)
+      next = hit.t2;
+    // Rounding at the entry point can put the first border just behind t
+    if (next > t)
+      recon_sum_add(&sum, (next - t) * (float)pixels[(size_t)iy * w + ix]);
+    t = next > t ? next : t;
+
+    if (next_x < next_y) {
+      ix += step_x;
+      next_x += delta_x;
+      if (ix < 0 || ix >= w)
+        break;
+    } else {
+      iy += step_y;
+      next_y += delta_y;
+      if (iy < 0 || iy >= h)
+        break;
+    }
+  }
+  return recon_sum_value(sum) / 255.0f;
+}
+
+static inline void simulate_views(void *ctx, size_t begin, size_t end, int thread) {
+  SimulateJob *job = (SimulateJob *)ctx;
+  const RaySet *rs = job->rs;
+
+  for (size_t r = begin * job->rays_per_view; r < end * job->rays_per_view; r++) {
+    const CTRay *ray = &rs->rays[r];
+    ReconSum b = recon_sum_zero();
+    for (int k = 0; k < job->sub_rays; k++) {
+      float dx = ray->dx * job->sub_cos[k] - ray->dy * job->sub_sin[k];
+      float dy = ray->dx * job->sub_sin[k] + ray->dy * job->sub_cos[k];
+      recon_sum_add(&b, simulate_ray(job->pixels, job->img_w, job->img_h, ray->ox, ray->oy, dx, dy));
+    }
+    rs->projections[r] = recon_sum_value(b) / ((float)job->sub_rays * job->cell_size);
+  }
+}
+
+// Fill rs->projections from the img_w x img_h slice, averaging sub_rays
+// sub-rays per ray. The rays must already be placed over the image
+// (rayset_translate). Multithreaded across source views.
+static inline void recon_simulate_projections(RaySet *rs, const unsigned char *pixels, int img_w, int img_h, int cell_size,
+                                              int sub_rays) {
+  SimulateJob job = {rs, pixels, img_w, img_h, (float)cell_size};
+  job.sub_rays = sub_rays < 1 ? 1 : sub_rays > SIMULATE_MAX_SUB_RAYS ? SIMULATE_MAX_SUB_RAYS : sub_rays;
+
+  // A fan ray stands for the angular interval between it and its neighbours
+  size_t views = rs->count;
+  job.rays_per_view = 1;
+  float spacing = 0.0f;
+  if (rs->type == RAY_MODE_FAN) {
+    job.rays_per_view = rs->metadata.fan.num_rays_per_source;
+    views = rs->metadata.fan.num_sources;
+    if (job.rays_per_view > 1)
+      spacing = rs->metadata.fan.angle_spread_rad / (float)(job.rays_per_view - 1);
+  }
+  for (int k = 0; k < job.sub_rays; k++) {
+    float offset = ((k + 0.5f) / job.sub_rays - 0.5f) * spacing;
+    job.sub_cos[k] = cosf(offset);
+    job.sub_sin[k] = sinf(offset);
+  }
+
+  parallel_for(views, simulate_views, &job);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "tiled.h"
+
+// SIRT: x <- clamp(x + lambda * C A^T R (b - A x)), with R and C the inverse
+// row and column sums of A. Every step is a full forward and back
+// projection, both run through the tile-binned projector.
+typedef struct {
+  const ReconTiledProjector *tp;
+  float lambda;
+  float *row_inv; // 1 / sum_j a_ij (rows)
+  float *col_inv; // 1 / sum_i a_ij (cells)
+  float *res;     // Weighted residual (rows)
+  float *bp;      // Back projected residual (cells)
+  int iteration;
+} ReconSirt;
+
+static inline ReconSirt recon_sirt_create(Arena *arena, const ReconTiledProjector *tp, float lambda) {
+  ReconSirt s = {.tp = tp, .lambda = lambda};
+  s.row_inv = (float *)arena_alloc(arena, tp->rows * sizeof(float));
+  s.col_inv = (float *)arena_alloc(arena, tp->n * sizeof(float));
+  s.res = (float *)arena_alloc(arena, tp->rows * sizeof(float));
+  s.bp = (float *)arena_alloc(arena, tp->n * sizeof(float));
+
+  for (int j = 0; j < tp->n; j++)
+    s.bp[j] = 1.0f;
+  recon_tiled_forward(tp, s.bp, s.row_inv);
+  for (size_t i = 0; i < tp->rows; i++) {
+    s.res[i] = 1.0f;
+    s.row_inv[i] = s.row_inv[i] > 1e-12f ? 1.0f / s.row_inv[i] : 0.0f;
+  }
+  recon_tiled_back(tp, s.res, s.col_inv);
+  for (int j = 0; j < tp->n; j++)
+    s.col_inv[j] = s.col_inv[j] > 1e-12f ? 1.0f / s.col_inv[j] : 0.0f;
+  return s;
+}
+
+static inline void recon_sirt_budget(ArenaBudget *b, size_t rows, int n) {
+  for (int i = 0; i < 2; i++) {
+    arena_budget(b, rows * sizeof(float));
+    arena_budget(b, n * sizeof(float));
+  }
+}
+
+static inline void recon_sirt_step(ReconSirt *s, float *x, const float *b, ReconBounds bounds) {
+  const ReconTiledProjector *tp = s->tp;
+  recon_tiled_forward(tp, x, s->res);
+  for (size_t i = 0; i < tp->rows; i++)
+    s->res[i] = (b[i] - s->res[i]) * s->row_inv[i];
+  recon_tiled_back(tp, s->res, s->bp);
+  for (int j = 0; j < tp->n; j++)
+    x[j] = recon_clamp(x[j] + s->lambda * s->col_inv[j] * s->bp[j], bounds);
+  s->iteration++;
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "matrix.h"
+#include "numerics.h"
+#include "ray.h"
+
+// Symmetry-aware system matrix store.
+//
+// Fan sources sit at uniform angles around the grid center, so on a square
+// grid centered on the fan the rows of a source rotated by 90 degrees, or
+// mirrored, are the rows of another source with the cells permuted. Only the
+// sources of a fundamental angular sector are stored; every other row is
+// derived by remapping column indices while it is used.
+
+// Dihedral group element: optional mirror (y -> -y) followed by k quarter turns
+typedef struct {
+  bool mirror;
+  int k;
+  // col' = p * col + q * iy + c, where iy = col / nx
+  long p, q, c;
+} SymOp;
+
+typedef struct {
+  ReconMatrix base;       // Rows of the sector sources only
+  size_t rays_per_source;
+  size_t sector_sources;  // Number of stored sources
+  uint8_t *source_op;     // Index into ops, per source
+  uint32_t *source_base;  // Stored source each source is derived from
+  SymOp ops[8];
+  int num_ops;
+  double inv_nx;
+} ReconSymMatrix;
+
+static inline SymOp symmetry_op(bool mirror, int k, int nx) {
+  // Track how (ix, iy) maps: ix' = ax*ix + bx*iy + cx, iy' = ay*ix + by*iy + cy
+  long m = nx - 1;
+  long ax = 1, bx = 0, cx = 0;
+  long ay = 0, by = 1, cy = 0;
+  if (mirror) {
+    by = -1;
+    cy = m;
+  }
+  for (int i = 0; i < k; i++) {
+    // Quarter turn about the center: ix' = m - iy, iy' = ix
+    long nax = -ay, nbx = -by, ncx = m - cy;
+    ay = ax;
+    by = bx;
+    cy = cx;
+    ax = nax;
+    bx = nbx;
+    cx = ncx;
+  }
+
+  long a = ay * nx + ax;
+  long b = by * nx + bx;
+  return (SymOp){.mirror = mirror, .k = k, .p = a, .q = b - a * nx, .c = cy * nx + cx};
+}
+
+// Source index reached from sector source i0 by an op
+static inline size_t symmetry_source(const SymOp *op, size_t i0, size_t num_sources) {
+  size_t quarter = num_sources / 4;
+  size_t base = op->mirror ? (num_sources - i0) % num_sources : i0;
+  return (base + (size_t)op->k * quarter) % num_sources;
+}
+
+// Build the store. Falls back to storing every source when the geometry is
+// not symmetric (non-square or blocked grid, grid not centered on the fan, or
+// a source count that is not a multiple of 4).
+static inline ReconSymMatrix recon_symmatrix_build(Arena *arena, const ReconGrid *g, const RaySet *rs, MatrixFormat format) {
+  ReconSymMatrix sm = {0};
+  RaySetFanMetadata fan = rs->metadata.fan;
+  size_t num_sources = fan.num_sources;
+  sm.rays_per_source = fan.num_rays_per_source;
+  sm.inv_nx = 1.0 / (double)g->nx;
+
+  // The ops are affine in row-major indices only
+  bool centered = g->layout == GRID_LAYOUT_ROW_MAJOR && g->nx == g->ny &&
+                  fan.cx == 0.5f * (float)(g->nx * g->cell_size) &&
+                  fan.cy == 0.5f * (float)(g->ny * g->cell_size);
+
+  if (rs->type == RAY_MODE_FAN && centered && num_sources % 8 == 0) {
+    for (int i = 0; i < 8; i++)
+      sm.ops[i] = symmetry_op(i >= 4, i % 4, g->nx);
+    sm.num_ops = 8;
+    sm.sector_sources = num_sources / 8 + 1;
+  } else if (rs->type == RAY_MODE_FAN && centered && num_sources % 4 == 0) {
+    for (int i = 0; i < 4; i++)
+      sm.ops[i] = symmetry_op(false, i, g->nx);
+    sm.num_ops = 4;
+    sm.sector_sources = num_sources / 4;
+  } else {
+    TraceLog(LOG_WARNING, "Geometry is not symmetric, storing all %zu sources", num_sources);
+    sm.ops[0] = symmetry_op(false, 0, g->nx);
+    sm.num_ops = 1;
+    sm.sector_sources = num_sources;
+  }
+
+  sm.source_op = (uint8_t *)arena_alloc(arena, num_sources * sizeof(uint8_t));
+  sm.source_base = (uint32_t *)arena_alloc(arena, num_sources * sizeof(uint32_t));
+  for (size_t i = 0; i < num_sources; i++)
+    sm.source_base[i] = UINT32_MAX;
+
+  // Identity first, so sector sources always map to themselves
+  for (int o = 0; o < sm.num_ops; o++) {
+    for (size_t i0 = 0; i0 < sm.sector_sources; i0++) {
+      size_t i = symmetry_source(&sm.ops[o], i0, num_sources);
+      if (sm.source_base[i] == UINT32_MAX) {
+        sm.source_base[i] = (uint32_t)i0;
+        sm.source_op[i] = (uint8_t)o;
+      }
+    }
+  }
+
+  // Sector rays are the first sources of the set, stored contiguously
+  RaySet sector = *rs;
+  sector.count = sm.sector_sources * sm.rays_per_source;
+  sm.base = recon_matrix_build(arena, g, &sector, format);
+  return sm;
+}
+
+// The sector is charged as the whole fan, which it is without symmetry
+static inline void recon_symmatrix_budget(ArenaBudget *b, const ReconGrid *g, size_t num_sources, size_t rows,
+                                          MatrixFormat format) {
+  arena_budget(b, num_sources * sizeof(uint8_t));
+  arena_budget(b, num_sources * sizeof(uint32_t));
+  recon_matrix_budget(b, g, rows, format);
+}
+
+// Stored row and op for ray r
+static inline size_t symmatrix_locate(const ReconSymMatrix *sm, size_t r, const SymOp **op) {
+  size_t src = r / sm->rays_per_source;
+  size_t j = r % sm->rays_per_source;
+  *op = &sm->ops[sm->source_op[src]];
+  // Mirroring reverses the order of rays within the fan
+  if ((*op)->mirror)
+    j = sm->rays_per_source - 1 - j;
+  return sm->source_base[src] * sm->rays_per_source + j;
+}
+
+static inline uint32_t symmetry_map_col(const SymOp *op, uint32_t col, double inv_nx) {
+  long iy = (long)(((double)col + 0.5) * inv_nx);
+  return (uint32_t)(op->p * (long)col + op->q * iy + op->c);
+}
+
+static inline float recon_symmatrix_row_dot(const ReconSymMatrix *sm, size_t r, const float *x) {
+  const SymOp *op;
+  size_t br = symmatrix_locate(sm, r, &op);
+  const ReconMatrix *m = &sm->base;
+  if (op->k == 0 && !op->mirror)
+    return recon_matrix_row_dot(m, br, x);
+
+  MatrixRowCursor c = matrix_row_cursor(m, br);
+  uint32_t cols[MATRIX_BLOCK];
+  float w[MATRIX_BLOCK];
+  ReconSum sum = recon_sum_zero();
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));)
+    for (uint32_t i = 0; i < len; i++)
+      recon_sum_add(&sum, w[i] * x[symmetry_map_col(op, cols[i], sm->inv_nx)]);
+  return recon_sum_value(sum);
+}
+
+static inline void recon_symmatrix_row_axpy(const ReconSymMatrix *sm, size_t r, float alpha, float *x) {
+  const SymOp *op;
+  size_t br = symmatrix_locate(sm, r, &op);
+  const ReconMatrix *m = &sm->base;
+  if (op->k == 0 && !op->mirror) {
+    recon_matrix_row_axpy(m, br, alpha, x);
+    return;
+  }
+
+  MatrixRowCursor c = matrix_row_cursor(m, br);
+  uint32_t cols[MATRIX_BLOCK];
+  float w[MATRIX_BLOCK];
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));)
+    for (uint32_t i = 0; i < len; i++)
+      x[symmetry_map_col(op, cols[i], sm->inv_nx)] += alpha * w[i];
+}
+
+static inline float recon_symmatrix_row_norm2(const ReconSymMatrix *sm, size_t r) {
+  const SymOp *op;
+  return sm->base.row_norm2[symmatrix_locate(sm, r, &op)];
+}
+
+static inline void recon_symmatrix_row_axpy_clamp(const ReconSymMatrix *sm, size_t r, float alpha, float *x, ReconBounds bounds) {
+  const SymOp *op;
+  size_t br = symmatrix_locate(sm, r, &op);
+  const ReconMatrix *m = &sm->base;
+  if (op->k == 0 && !op->mirror) {
+    recon_matrix_row_axpy_clamp(m, br, alpha, x, bounds);
+    return;
+  }
+
+  MatrixRowCursor c = matrix_row_cursor(m, br);
+  uint32_t cols[MATRIX_BLOCK];
+  float w[MATRIX_BLOCK];
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols, w));) {
+    for (uint32_t i = 0; i < len; i++) {
+      uint32_t col = symmetry_map_col(op, cols[i], sm->inv_nx);
+      x[col] = recon_clamp(x[col] + alpha * w[i], bounds);
+    }
+  }
+}
+
+// Run one iteration over all rays from a fan source using the symmetric store
+static inline void recon_symmatrix_iterate_fan(const ReconSymMatrix *sm, ReconGrid *g, const RaySet *rs, size_t iteration) {
+  size_t begin, end;
+  if (!rayset_fan_rows(rs, iteration, &begin, &end))
+    return;
+  for (size_t i = begin; i < end; i++) {
+    float norm_a = recon_symmatrix_row_norm2(sm, i);
+    if (norm_a < 1e-12f)
+      continue;
+    float alpha = (rs->projections[i] - recon_symmatrix_row_dot(sm, i, g->values)) / norm_a;
+    recon_symmatrix_row_axpy(sm, i, alpha, g->values);
+  }
+  // Stored rectangles are for the base sector only
+  recon_grid_touch_all(g);
+}
+
+// Constrained variant of recon_symmatrix_iterate_fan
+static inline void recon_symmatrix_iterate_fan_clamp(const ReconSymMatrix *sm, ReconGrid *g, const RaySet *rs, size_t iteration,
+                                                     ReconBounds bounds) {
+  size_t begin, end;
+  if (!rayset_fan_rows(rs, iteration, &begin, &end))
+    return;
+  for (size_t i = begin; i < end; i++) {
+    float norm_a = recon_symmatrix_row_norm2(sm, i);
+    if (norm_a < 1e-12f)
+      continue;
+    float alpha = (rs->projections[i] - recon_symmatrix_row_dot(sm, i, g->values)) / norm_a;
+    recon_symmatrix_row_axpy_clamp(sm, i, alpha, g->values, bounds);
+  }
+  recon_grid_touch_all(g);
+}
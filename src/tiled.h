@@ -0,0 +1,291 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "matrix.h"
+#include "numerics.h"
+#include "parallel.h"
+
+// Tile-binned projector for full-grid sweeps (SIRT, back projection).
+//
+// A row of the matrix walks a long diagonal through the grid, so projecting
+// row by row touches cache lines all over `values`. Here the grid is split
+// into square tiles and the matrix entries are re-binned per tile in a
+// precomputed pass. Inside a tile, entries are grouped into runs, one run
+// per ray crossing the tile, in ray order.
+//
+// The tile edge comes from a cache budget: a tile's cells should stay in
+// cache while its runs are processed. It is then shrunk until the grid has
+// enough tiles to go around the workers.
+//
+// Threads take contiguous ranges of whole tiles, cut so that every range
+// holds about the same number of segments (matrix entries):
+// - Back projection writes only its own tile's cells, so it needs no atomics
+//   or per-thread images, and the result does not depend on the thread count.
+// - Forward projection writes one partial sum per run, and the runs of each
+//   ray are then summed in a fixed order.
+
+#define TILED_CACHE_BYTES (16 * 1024) // Cells of one tile, about half an L1 data cache
+#define TILED_MIN_TILES 16             // Fewest tiles, if the grid allows, or one per worker if more
+#define TILED_CHUNKS_PER_THREAD 4      // Segment-balanced tile ranges per worker
+
+typedef struct {
+  int tile;             // Tile edge in cells
+  int tiles_x, tiles_y;
+  int num_tiles;
+  size_t rows;
+  int n;
+  size_t *tile_run_start;  // num_tiles + 1 offsets into the run arrays
+  uint32_t *run_row;       // Ray of each run
+  uint32_t *run_start;     // num_runs + 1 offsets into seg_col / seg_w
+  uint32_t *seg_col;       // Cell of each segment
+  float *seg_w;            // Weight of each segment
+  uint32_t *row_run_start; // rows + 1 offsets into row_runs
+  uint32_t *row_runs;      // Runs of each ray, in tile order
+  float *run_partial;      // Forward projection partial sum per run
+  int num_chunks;
+  int *chunk_tile_start;   // num_chunks + 1 offsets into the tiles
+} ReconTiledProjector;
+
+// Largest tile edge whose cells fit TILED_CACHE_BYTES, shrunk until the grid
+// has at least TILED_MIN_TILES tiles and one per worker. Blocked grids keep
+// whole 8x8 blocks in a tile.
+static inline int recon_tiled_default_tile(const ReconGrid *g) {
+  int align = g->layout == GRID_LAYOUT_BLOCKED ? GRID_BLOCK : 1;
+  int min_tiles = parallel_num_threads() > TILED_MIN_TILES ? parallel_num_threads() : TILED_MIN_TILES;
+  int tile = (int)sqrtf((float)(TILED_CACHE_BYTES / sizeof(float)));
+  tile -= tile % align;
+  while (tile > align && ((g->nx + tile - 1) / tile) * ((g->ny + tile - 1) / tile) < min_tiles)
+    tile -= align;
+  return tile;
+}
+
+static inline int tiled_tile_of(const ReconTiledProjector *tp, const ReconGrid *g, uint32_t col) {
+  int ix, iy;
+  recon_grid_coords(g, (int)col, &ix, &iy);
+  return (iy / tp->tile) * tp->tiles_x + ix / tp->tile;
+}
+
+// Expand row r of the matrix into cols / weights, returns the entry count
+static inline int tiled_decode_row(const ReconMatrix *m, size_t r, uint32_t *cols, float *weights) {
+  MatrixRowCursor c = matrix_row_cursor(m, r);
+  float w[MATRIX_BLOCK];
+  int count = 0;
+  for (uint32_t len; (len = matrix_row_next(m, &c, cols + count, w)); count += (int)len)
+    memcpy(weights + count, w, len * sizeof(float));
+  return count;
+}
+
+static inline ReconTiledProjector recon_tiled_build(Arena *arena, const ReconMatrix *m, const ReconGrid *g, int tile) {
+  ReconTiledProjector tp = {0};
+  tp.tile = tile > 0 ? tile : recon_tiled_default_tile(g);
+  tp.tiles_x = (g->nx + tp.tile - 1) / tp.tile;
+  tp.tiles_y = (g->ny + tp.tile - 1) / tp.tile;
+  tp.num_tiles = tp.tiles_x * tp.tiles_y;
+  tp.rows = m->rows;
+  tp.n = g->n;
+
+  int max_row = g->nx + g->ny;
+  size_t num_tiles = (size_t)tp.num_tiles;
+  tp.tile_run_start = (size_t *)arena_alloc(arena, (num_tiles + 1) * sizeof(size_t));
+  tp.row_run_start = (uint32_t *)arena_alloc_zero(arena, (m->rows + 1) * sizeof(uint32_t));
+  tp.seg_col = (uint32_t *)arena_alloc(arena, m->nnz * sizeof(uint32_t));
+  tp.seg_w = (float *)arena_alloc(arena, m->nnz * sizeof(float));
+
+  // Counting pass: runs per tile and per row
+  ArenaMark mark = arena_mark(arena);
+  size_t *tile_runs = (size_t *)arena_alloc_zero(arena, num_tiles * sizeof(size_t));
+  uint32_t *last_row = (uint32_t *)arena_alloc(arena, num_tiles * sizeof(uint32_t));
+  uint32_t *cols = (uint32_t *)arena_alloc(arena, max_row * sizeof(uint32_t));
+  float *weights = (float *)arena_alloc(arena, max_row * sizeof(float));
+  for (size_t t = 0; t < num_tiles; t++)
+    last_row[t] = UINT32_MAX;
+
+  for (size_t r = 0; r < m->rows; r++) {
+    int count = tiled_decode_row(m, r, cols, weights);
+    for (int i = 0; i < count; i++) {
+      int t = tiled_tile_of(&tp, g, cols[i]);
+      if (last_row[t] != (uint32_t)r) {
+        last_row[t] = (uint32_t)r;
+        tile_runs[t]++;
+        tp.row_run_start[r + 1]++;
+      }
+    }
+  }
+
+  size_t num_runs = 0;
+  for (size_t t = 0; t < num_tiles; t++) {
+    tp.tile_run_start[t] = num_runs;
+    num_runs += tile_runs[t];
+  }
+  tp.tile_run_start[num_tiles] = num_runs;
+  for (size_t r = 0; r < m->rows; r++)
+    tp.row_run_start[r + 1] += tp.row_run_start[r];
+
+  // Final arrays go below the scratch so it can be released afterwards
+  arena_rewind(arena, mark);
+  tp.run_row = (uint32_t *)arena_alloc(arena, num_runs * sizeof(uint32_t));
+  tp.run_start = (uint32_t *)arena_alloc(arena, (num_runs + 1) * sizeof(uint32_t));
+  tp.row_runs = (uint32_t *)arena_alloc(arena, num_runs * sizeof(uint32_t));
+  tp.run_partial = (float *)arena_alloc(arena, num_runs * sizeof(float));
+
+  // Fill pass: segments per tile, then every segment in ray order
+  mark = arena_mark(arena);
+  size_t *next_seg = (size_t *)arena_alloc_zero(arena, num_tiles * sizeof(size_t));
+  size_t *next_run = (size_t *)arena_alloc(arena, num_tiles * sizeof(size_t));
+  uint32_t *row_fill = (uint32_t *)arena_alloc_zero(arena, m->rows * sizeof(uint32_t));
+  last_row = (uint32_t *)arena_alloc(arena, num_tiles * sizeof(uint32_t));
+  cols = (uint32_t *)arena_alloc(arena, max_row * sizeof(uint32_t));
+  weights = (float *)arena_alloc(arena, max_row * sizeof(float));
+
+  for (size_t r = 0; r < m->rows; r++) {
+    int count = tiled_decode_row(m, r, cols, weights);
+    for (int i = 0; i < count; i++)
+      next_seg[tiled_tile_of(&tp, g, cols[i])]++;
+  }
+  size_t seg = 0;
+  for (size_t t = 0; t < num_tiles; t++) {
+    size_t c = next_seg[t];
+    next_seg[t] = seg;
+    seg += c;
+    next_run[t] = tp.tile_run_start[t];
+    last_row[t] = UINT32_MAX;
+  }
+
+  for (size_t r = 0; r < m->rows; r++) {
+    int count = tiled_decode_row(m, r, cols, weights);
+    for (int i = 0; i < count; i++) {
+      int t = tiled_tile_of(&tp, g, cols[i]);
+      if (last_row[t] != (uint32_t)r) {
+        last_row[t] = (uint32_t)r;
+        size_t run = next_run[t]++;
+        tp.run_row[run] = (uint32_t)r;
+        tp.run_start[run] = (uint32_t)next_seg[t];
+      }
+      tp.seg_col[next_seg[t]] = cols[i];
+      tp.seg_w[next_seg[t]] = weights[i];
+      next_seg[t]++;
+    }
+  }
+  tp.run_start[num_runs] = (uint32_t)m->nnz;
+
+  // Runs of each ray in tile order, so the forward sum order is fixed
+  for (size_t run = 0; run < num_runs; run++) {
+    uint32_t r = tp.run_row[run];
+    tp.row_runs[tp.row_run_start[r] + row_fill[r]++] = (uint32_t)run;
+  }
+  arena_rewind(arena, mark);
+
+  // Tile ranges with about the same number of segments each
+  tp.num_chunks = parallel_num_threads() * TILED_CHUNKS_PER_THREAD;
+  if (tp.num_chunks > tp.num_tiles)
+    tp.num_chunks = tp.num_tiles;
+  tp.chunk_tile_start = (int *)arena_alloc(arena, (tp.num_chunks + 1) * sizeof(int));
+  int t = 0;
+  for (int c = 0; c < tp.num_chunks; c++) {
+    size_t target = m->nnz * c / tp.num_chunks;
+    while (t < tp.num_tiles && tp.run_start[tp.tile_run_start[t]] < target)
+      t++;
+    tp.chunk_tile_start[c] = t;
+  }
+  tp.chunk_tile_start[tp.num_chunks] = tp.num_tiles;
+
+  return tp;
+}
+
+// What recon_tiled_build allocates over a matrix of `rows` rays: every row
+// has at most nx + ny segments and crosses at most tiles_x + tiles_y tiles
+static inline void recon_tiled_budget(ArenaBudget *b, const ReconGrid *g, size_t rows, int tile) {
+  if (tile <= 0)
+    tile = recon_tiled_default_tile(g);
+  size_t tiles_x = (g->nx + tile - 1) / tile;
+  size_t tiles_y = (g->ny + tile - 1) / tile;
+  size_t num_tiles = tiles_x * tiles_y;
+  size_t max_row = (size_t)(g->nx + g->ny);
+  size_t nnz = rows * max_row;
+  size_t num_runs = rows * (tiles_x + tiles_y < num_tiles ? tiles_x + tiles_y : num_tiles);
+
+  arena_budget(b, (num_tiles + 1) * sizeof(size_t));
+  arena_budget(b, (rows + 1) * sizeof(uint32_t));
+  arena_budget(b, nnz * sizeof(uint32_t));
+  arena_budget(b, nnz * sizeof(float));
+  for (int pass = 0; pass < 2; pass++) {
+    arena_budget(b, num_tiles * sizeof(size_t));
+    arena_budget(b, num_tiles * sizeof(uint32_t));
+    arena_budget(b, max_row * sizeof(uint32_t));
+    arena_budget(b, max_row * sizeof(float));
+  }
+  arena_budget(b, num_runs * sizeof(uint32_t));
+  arena_budget(b, (num_runs + 1) * sizeof(uint32_t));
+  arena_budget(b, num_runs * sizeof(uint32_t));
+  arena_budget(b, num_runs * sizeof(float));
+  arena_budget(b, num_tiles * sizeof(size_t));
+  arena_budget(b, rows * sizeof(uint32_t));
+
+  size_t num_chunks = (size_t)parallel_num_threads() * TILED_CHUNKS_PER_THREAD;
+  arena_budget(b, ((num_chunks < num_tiles ? num_chunks : num_tiles) + 1) * sizeof(int));
+}
+
+typedef struct {
+  const ReconTiledProjector *tp;
+  const float *in;
+  float *out;
+} TiledJob;
+
+// Runs of the tiles in chunks [begin, end)
+static inline void tiled_chunk_runs(const ReconTiledProjector *tp, size_t begin, size_t end, size_t *first, size_t *last) {
+  *first = tp->tile_run_start[tp->chunk_tile_start[begin]];
+  *last = tp->tile_run_start[tp->chunk_tile_start[end]];
+}
+
+static inline void tiled_forward_tiles(void *ctx, size_t begin, size_t end, int thread) {
+  TiledJob *job = (TiledJob *)ctx;
+  const ReconTiledProjector *tp = job->tp;
+  size_t first, last;
+  tiled_chunk_runs(tp, begin, end, &first, &last);
+  for (size_t run = first; run < last; run++) {
+    ReconSum sum = recon_sum_zero();
+    for (uint32_t s = tp->run_start[run]; s < tp->run_start[run + 1]; s++)
+      recon_sum_add(&sum, tp->seg_w[s] * job->in[tp->seg_col[s]]);
+    tp->run_partial[run] = recon_sum_value(sum);
+  }
+}
+
+static inline void tiled_forward_rows(void *ctx, size_t begin, size_t end, int thread) {
+  TiledJob *job = (TiledJob *)ctx;
+  const ReconTiledProjector *tp = job->tp;
+  for (size_t r = begin; r < end; r++) {
+    ReconSum sum = recon_sum_zero();
+    for (uint32_t k = tp->row_run_start[r]; k < tp->row_run_start[r + 1]; k++)
+      recon_sum_add(&sum, tp->run_partial[tp->row_runs[k]]);
+    job->out[r] = recon_sum_value(sum);
+  }
+}
+
+static inline void tiled_back_tiles(void *ctx, size_t begin, size_t end, int thread) {
+  TiledJob *job = (TiledJob *)ctx;
+  const ReconTiledProjector *tp = job->tp;
+  size_t first, last;
+  tiled_chunk_runs(tp, begin, end, &first, &last);
+  for (size_t run = first; run < last; run++) {
+    float v = job->in[tp->run_row[run]];
+    if (v == 0.0f)
+      continue;
+    for (uint32_t s = tp->run_start[run]; s < tp->run_start[run + 1]; s++)
+      job->out[tp->seg_col[s]] += v * tp->seg_w[s];
+  }
+}
+
+// y = A x
+static inline void recon_tiled_forward(const ReconTiledProjector *tp, const float *x, float *y) {
+  TiledJob job = {tp, x, y};
+  parallel_for((size_t)tp->num_chunks, tiled_forward_tiles, &job);
+  parallel_for(tp->rows, tiled_forward_rows, &job);
+}
+
+// x = A^T y
+static inline void recon_tiled_back(const ReconTiledProjector *tp, const float *y, float *x) {
+  TiledJob job = {tp, y, x};
+  memset(x, 0, (size_t)tp->n * sizeof(float));
+  parallel_for((size_t)tp->num_chunks, tiled_back_tiles, &job);
+}
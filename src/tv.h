@@ -0,0 +1,199 @@
+#pragma once
+
+#include "arena.h"
+#include "art.h"
+#include "parallel.h"
+#include "simd.h"
+#include <math.h>
+
+// Total-variation minimization between ART sweeps (ART-TV, ASD-POCS style).
+//
+// After each sweep the image takes `steps` gradient-descent steps on the
+// smoothed isotropic TV, sum sqrt(dx^2 + dy^2 + eps). The step length is
+// `alpha` times the change the sweep itself made, so the TV pull shrinks as
+// the data term converges.
+//
+// The gradient is a two-stage stencil (normalized forward differences, then
+// their divergence). Each thread owns a contiguous range of rows and walks it
+// in bands small enough that both stages stay in cache. A blocked grid is
+// gathered into a row-major copy first and scattered back afterwards.
+
+#define TV_BAND_BYTES (64 * 1024)
+
+typedef struct {
+  int steps;     // Descent steps per call
+  float alpha;   // Step length relative to the last sweep's change
+  float eps;     // Smoothing of |grad x| near zero
+  int nx, ny;
+  int n;         // Stored cells of the grid
+  const ReconGrid *grid;
+  int band_rows; // Rows per cache block
+  float *grad;   // TV gradient (n)
+  float *prev;   // Image before the sweep (n)
+  float *image;  // Row-major copy of a blocked grid (nx * ny)
+  float *band;   // Per-thread px/py rows plus a zero row
+  double *sums;  // Per-thread partial sums
+} ReconTv;
+
+static inline int tv_band_rows(const ReconGrid *g) {
+  int rows = TV_BAND_BYTES / (int)(2 * g->nx * sizeof(float));
+  if (rows < 1)
+    rows = 1;
+  return rows > g->ny ? g->ny : rows;
+}
+
+static inline ReconTv recon_tv_create(Arena *arena, const ReconGrid *g, int steps, float alpha) {
+  ReconTv tv = {.steps = steps, .alpha = alpha, .eps = 1e-8f, .nx = g->nx, .ny = g->ny, .n = g->n, .grid = g};
+  int threads = parallel_num_threads();
+  tv.band_rows = tv_band_rows(g);
+
+  tv.grad = (float *)arena_alloc(arena, g->n * sizeof(float));
+  tv.prev = (float *)arena_alloc(arena, g->n * sizeof(float));
+  if (g->layout != GRID_LAYOUT_ROW_MAJOR)
+    tv.image = (float *)arena_alloc(arena, (size_t)g->nx * g->ny * sizeof(float));
+  tv.band = (float *)arena_alloc_zero(arena, (size_t)threads * (2 * (tv.band_rows + 1) + 1) * g->nx * sizeof(float));
+  tv.sums = (double *)arena_alloc(arena, threads * sizeof(double));
+  return tv;
+}
+
+static inline void recon_tv_budget(ArenaBudget *b, const ReconGrid *g) {
+  int threads = parallel_num_threads();
+  arena_budget(b, g->n * sizeof(float));
+  arena_budget(b, g->n * sizeof(float));
+  if (g->layout != GRID_LAYOUT_ROW_MAJOR)
+    arena_budget(b, (size_t)g->nx * g->ny * sizeof(float));
+  arena_budget(b, (size_t)threads * (2 * (tv_band_rows(g) + 1) + 1) * g->nx * sizeof(float));
+  arena_budget(b, threads * sizeof(double));
+}
+
+// px = dx / s, py = dy / s for one row; dx/dy are zero past the last column/row
+static inline void tv_normalized_diffs(const ReconTv *tv, const float *x, int iy, float *px, float *py) {
+  int nx = tv->nx;
+  const float *row = x + (size_t)iy * nx;
+  const float *below = iy < tv->ny - 1 ? row + nx : row;
+  f32x4 eps = f32x4_set1(tv->eps);
+
+  int ix = 0;
+  for (; ix + 4 < nx; ix += 4) {
+    f32x4 c = f32x4_load(row + ix);
+    f32x4 dx = f32x4_sub(f32x4_load(row + ix + 1), c);
+    f32x4 dy = f32x4_sub(f32x4_load(below + ix), c);
+    f32x4 s = f32x4_sqrt(f32x4_add(f32x4_add(f32x4_mul(dx, dx), f32x4_mul(dy, dy)), eps));
+    f32x4_store(px + ix, f32x4_div(dx, s));
+    f32x4_store(py + ix, f32x4_div(dy, s));
+  }
+  for (; ix < nx; ix++) {
+    float dx = ix < nx - 1 ? row[ix + 1] - row[ix] : 0.0f;
+    float dy = below[ix] - row[ix];
+    float s = sqrtf(dx * dx + dy * dy + tv->eps);
+    px[ix] = dx / s;
+    py[ix] = dy / s;
+  }
+}
+
+typedef struct {
+  ReconTv *tv;
+  float *x;
+  float step;
+} TvJob;
+
+static inline void tv_gradient_range(void *ctx, size_t begin, size_t end, int thread) {
+  TvJob *job = (TvJob *)ctx;
+  ReconTv *tv = job->tv;
+  int nx = tv->nx;
+  size_t stride = (size_t)(2 * (tv->band_rows + 1) + 1) * nx;
+  float *pxs = tv->band + (size_t)thread * stride;
+  float *pys = pxs + (size_t)(tv->band_rows + 1) * nx;
+  const float *zero = pys + (size_t)(tv->band_rows + 1) * nx;
+  double sum = 0.0;
+
+  for (int b0 = (int)begin; b0 < (int)end; b0 += tv->band_rows) {
+    int b1 = b0 + tv->band_rows < (int)end ? b0 + tv->band_rows : (int)end;
+
+    // Band row 0 holds the row above b0, needed for py(iy - 1)
+    for (int iy = b0 > 0 ? b0 - 1 : 0; iy < b1; iy++)
+      tv_normalized_diffs(tv, job->x, iy, pxs + (size_t)(iy - b0 + 1) * nx, pys + (size_t)(iy - b0 + 1) * nx);
+
+    for (int iy = b0; iy < b1; iy++) {
+      const float *px = pxs + (size_t)(iy - b0 + 1) * nx;
+      const float *py = pys + (size_t)(iy - b0 + 1) * nx;
+      const float *py_up = iy > 0 ? py - nx : zero;
+      float *g = tv->grad + (size_t)iy * nx;
+
+      // grad = -div(p)
+      g[0] = -(px[0] + py[0]) + py_up[0];
+      for (int ix = 1; ix < nx; ix++)
+        g[ix] = -(px[ix] + py[ix]) + px[ix - 1] + py_up[ix];
+      for (int ix = 0; ix < nx; ix++)
+        sum += (double)g[ix] * g[ix];
+    }
+  }
+  tv->sums[thread] = sum;
+}
+
+static inline void tv_descend_range(void *ctx, size_t begin, size_t end, int thread) {
+  TvJob *job = (TvJob *)ctx;
+  const float *g = job->tv->grad;
+  f32x4 step = f32x4_set1(job->step);
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4)
+    f32x4_store(job->x + i, f32x4_sub(f32x4_load(job->x + i), f32x4_mul(step, f32x4_load(g + i))));
+  for (; i < end; i++)
+    job->x[i] -= job->step * g[i];
+}
+
+// Snapshot the image before an ART sweep
+static inline void recon_tv_begin(ReconTv *tv, const float *x) {
+  memcpy(tv->prev, x, (size_t)tv->n * sizeof(float));
+}
+
+// Copy between grid storage and the row-major image
+static inline void tv_gather(const ReconTv *tv, const float *x) {
+  for (int iy = 0; iy < tv->ny; iy++)
+    for (int ix = 0; ix < tv->nx; ix++)
+      tv->image[(size_t)iy * tv->nx + ix] = x[recon_grid_index(tv->grid, ix, iy)];
+}
+
+static inline void tv_scatter(const ReconTv *tv, float *x) {
+  for (int iy = 0; iy < tv->ny; iy++)
+    for (int ix = 0; ix < tv->nx; ix++)
+      x[recon_grid_index(tv->grid, ix, iy)] = tv->image[(size_t)iy * tv->nx + ix];
+}
+
+// Run the TV descent steps after a sweep
+static inline void recon_tv_minimize(ReconTv *tv, float *x) {
+  double change = 0.0;
+  for (int i = 0; i < tv->n; i++) {
+    double d = x[i] - tv->prev[i];
+    change += d * d;
+  }
+  float dtvg = tv->alpha * (float)sqrt(change);
+  if (dtvg <= 0.0f)
+    return;
+
+  float *img = x;
+  if (tv->image) {
+    tv_gather(tv, x);
+    img = tv->image;
+  }
+
+  size_t n = (size_t)tv->nx * tv->ny;
+  int threads = parallel_num_threads();
+  TvJob job = {tv, img, 0.0f};
+  for (int s = 0; s < tv->steps; s++) {
+    parallel_for((size_t)tv->ny, tv_gradient_range, &job);
+
+    double norm = 0.0;
+    for (int t = 0; t < threads; t++)
+      norm += tv->sums[t];
+    norm = sqrt(norm);
+    if (norm < 1e-12)
+      break;
+
+    job.step = dtvg / (float)norm;
+    parallel_for(n, tv_descend_range, &job);
+  }
+
+  if (tv->image)
+    tv_scatter(tv, x);
+}
@@ -3,6 +3,8 @@
 #include "art.h"
 #include "ray.h"
 #include "raylib.h"
+#include "rlgl.h"
+#include "simd.h"
 #include <stdio.h>
 
 #ifdef __EMSCRIPTEN__
@@ -155,6 +157,22 @@ static inline void ui_draw_image_panel(Texture2D tex, int x, int y, int padding,
   DrawText(label, x, y - padding - 22, 18, UI_TEXT_COLOR);
 }
 
+// Draw a grid-resolution texture scaled up to an img_w x img_h panel. The
+// source rectangle crops the part of the last cells past the image edge.
+static inline void ui_draw_grid_panel(Texture2D tex, int cell_size, int img_w, int img_h, int x, int y, int padding,
+                                      const char *label) {
+  Rectangle border = {(float)(x - padding), (float)(y - padding),
+                      (float)(img_w + padding * 2),
+                      (float)(img_h + padding * 2)};
+  Rectangle src = {0.0f, 0.0f, (float)img_w / (float)cell_size, (float)img_h / (float)cell_size};
+  Rectangle dst = {(float)x, (float)y, (float)img_w, (float)img_h};
+
+  DrawRectangleRec(border, BLACK);
+  DrawRectangleLinesEx(border, 1, UI_BORDER_COLOR);
+  DrawTexturePro(tex, src, dst, (Vector2){0.0f, 0.0f}, 0.0f, WHITE);
+  DrawText(label, x, y - padding - 22, 18, UI_TEXT_COLOR);
+}
+
 // Draw top bar
 static inline void ui_draw_top_bar(int screen_w, const UIState *ui, int img_w, int img_h, int nx, int ny) {
   DrawRectangle(0, 0, screen_w, UI_TOP_BAR_HEIGHT, UI_PANEL_COLOR);
@@ -185,77 +203,152 @@ static inline void ui_draw_top_bar(int screen_w, const UIState *ui, int img_w, i
   DrawText("Show/Hide Info", bx + 10, 16, 14, UI_TEXT_COLOR);
 }
 
+// Map reconstruction space (the box_w x box_h box the RaySet lives in, the
+// whole grid including its partial last cells) onto a w x h panel at (x, y),
+// the same fit rayset_translate uses. Geometry stays untouched; pair with
+// ui_end_recon_view.
+static inline void ui_begin_recon_view(int x, int y, int w, int h, int box_w, int box_h) {
+  float scale = fmaxf((float)w, (float)h) / fmaxf((float)box_w, (float)box_h);
+  rlPushMatrix();
+  rlTranslatef(x + 0.5f * w, y + 0.5f * h, 0.0f);
+  rlScalef(scale, scale, 1.0f);
+  rlTranslatef(-0.5f * box_w, -0.5f * box_h, 0.0f);
+}
+
+static inline void ui_end_recon_view(void) { rlPopMatrix(); }
+
+// Ray segments of every source, built once per ray set as line vertices in
+// unit fan space (center 0, radius 1). Drawing places them with the rlgl
+// matrix stack, so a fan is one batch of vertices with no per-ray math and
+// moving or resizing the fan does not touch the cache.
+typedef struct {
+  float *vertices; // x0, y0, x1, y1 per ray
+  size_t num_sources;
+  size_t rays_per_source;
+} UIRayCache;
+
+static inline UIRayCache ui_ray_cache_build(Arena *arena, const RaySet *rs) {
+  RaySetFanMetadata fan = rs->metadata.fan;
+  UIRayCache c = {.num_sources = fan.num_sources, .rays_per_source = fan.num_rays_per_source};
+  c.vertices = (float *)arena_alloc(arena, rs->count * 4 * sizeof(float));
+
+  for (size_t i = 0; i < rs->count; i++) {
+    CTRay ray = rs->rays[i];
+    float ox = (ray.ox - fan.cx) / fan.radius;
+    float oy = (ray.oy - fan.cy) / fan.radius;
+    // Rays span the fan's diameter
+    c.vertices[4 * i + 0] = ox;
+    c.vertices[4 * i + 1] = oy;
+    c.vertices[4 * i + 2] = ox + ray.dx * 2.0f;
+    c.vertices[4 * i + 3] = oy + ray.dy * 2.0f;
+  }
+  return c;
+}
+
+// Draw `count` consecutive source fans starting at `first` in one line batch
+static inline void ui_draw_ray_fans(const UIRayCache *c, const RaySetFanMetadata *fan, size_t first, size_t count) {
+  rlPushMatrix();
+  rlTranslatef(fan->cx, fan->cy, 0.0f);
+  rlScalef(fan->radius, fan->radius, 1.0f);
+
+  rlBegin(RL_LINES);
+  rlColor4ub(UI_RAY_COLOR.r, UI_RAY_COLOR.g, UI_RAY_COLOR.b, UI_RAY_COLOR.a);
+  for (size_t s = first; s < first + count; s++) {
+    const float *v = c->vertices + (s % c->num_sources) * c->rays_per_source * 4;
+    for (size_t i = 0; i < c->rays_per_source; i++, v += 4) {
+      rlVertex2f(v[0], v[1]);
+      rlVertex2f(v[2], v[3]);
+    }
+  }
+  rlEnd();
+
+  rlPopMatrix();
+}
+
 // Draw rays visualization
-static inline void ui_draw_rays(const RaySet *rs, size_t iteration) {
+static inline void ui_draw_rays(const UIRayCache *c, const RaySet *rs, size_t iteration) {
   if (rs->type != RAY_MODE_FAN) {
     TraceLog(LOG_INFO, "NOT FAN");
     return;
   }
-  size_t startIndex = iteration * rs->metadata.fan.num_rays_per_source;
-  size_t endIndex = startIndex + rs->metadata.fan.num_rays_per_source;
+  const RaySetFanMetadata *fan = &rs->metadata.fan;
+  ui_draw_ray_fans(c, fan, iteration, 1);
 
-  CTRay ray;
-  for (size_t i = startIndex; i < endIndex; i++) {
-    ray = rs->rays[i];
+  const float *source = c->vertices + iteration * c->rays_per_source * 4;
+  DrawCircle(fan->cx + source[0] * fan->radius, fan->cy + source[1] * fan->radius, 5, UI_RAY_COLOR);
+  // debugging circle - fuck trig
+  DrawCircleLines(fan->cx, fan->cy, fan->radius, UI_RAY_COLOR);
+}
 
-    Vector2 p1 = {ray.ox, ray.oy};
-    Vector2 p2 = {ray.ox + ray.dx * ray.length, ray.oy + ray.dy * ray.length};
-    // TraceLog(LOG_INFO, "RAY %d (%f,%f) -> (%f %f)", i, ray.ox, ray.oy, p2.x, p2.y);
-    DrawLineEx(p1, p2, 1.5f, UI_RAY_COLOR);
-  }
+// Grid-resolution textures: one texel per cell, scaled up by the GPU with
+// point filtering instead of writing cell_size^2 pixels per cell on the CPU.
+// The pixel buffer stays owned by the caller and is reused for updates.
+static inline Texture2D ui_load_grid_texture(void *pixels, const ReconGrid *g, int format) {
+  Image im = {.data = pixels, .width = g->nx, .height = g->ny, .mipmaps = 1, .format = format};
+  Texture2D tex = LoadTextureFromImage(im);
+  SetTextureFilter(tex, TEXTURE_FILTER_POINT);
+  return tex;
+}
 
-  DrawCircle(ray.ox, ray.oy, 5, UI_RAY_COLOR);
-  // debugging circle - fuck trig
-  DrawCircleLines(rs->metadata.fan.cx, rs->metadata.fan.cy, rs->metadata.fan.radius, UI_RAY_COLOR);
+// Texture area of a cell rectangle, for UpdateTextureRec
+static inline Rectangle ui_rect_to_texture(ReconRect r) {
+  return (Rectangle){(float)r.x0, (float)r.y0, (float)(r.x1 - r.x0), (float)(r.y1 - r.y0)};
 }
 
-// Update reconstruction image from grid values
-static inline void ui_update_recon_texture(Color *pixels, const ReconGrid *g, int img_w, int img_h) {
-  for (int iy = 0; iy < g->ny; iy++) {
-    for (int ix = 0; ix < g->nx; ix++) {
-      float val = g->values[iy * g->nx + ix];
-
-      // Scale from [0,1] back to [0,255] for display
-      unsigned char v = (unsigned char)(val * 255.0f);
-
-      for (int yy = 0; yy < g->cell_size; yy++) {
-        for (int xx = 0; xx < g->cell_size; xx++) {
-          int px = ix * g->cell_size + xx;
-          int py = iy * g->cell_size + yy;
-          if (px < img_w && py < img_h)
-            pixels[py * img_w + px] = (Color){v, v, v, 255};
-        }
+// Update reconstruction image (one grey byte per cell) from grid values.
+// Only cells in r are written, packed with a row stride of r's width.
+// Scale from [0,1] back to [0,255] for display; out-of-range values from
+// unconstrained solvers would otherwise wrap around.
+static inline void ui_update_recon_texture(unsigned char *pixels, const ReconGrid *g, ReconRect r) {
+  int w = r.x1 - r.x0;
+  f32x4 lo = f32x4_set1(0.0f), hi = f32x4_set1(1.0f), s255 = f32x4_set1(255.0f);
+  for (int iy = r.y0; iy < r.y1; iy++) {
+    unsigned char *out = pixels + (iy - r.y0) * w;
+    for (int ix = r.x0; ix < r.x1;) {
+      int run = recon_grid_run(g, ix, r.x1);
+      const float *v = g->values + recon_grid_index(g, ix, iy);
+      int k = 0;
+      for (; k + 4 <= run; k += 4) {
+        float q[4];
+        f32x4_store(q, f32x4_mul(f32x4_min(f32x4_max(f32x4_load(v + k), lo), hi), s255));
+        for (int j = 0; j < 4; j++)
+          out[ix - r.x0 + k + j] = (unsigned char)q[j];
       }
+      for (; k < run; k++)
+        out[ix - r.x0 + k] = (unsigned char)(fminf(fmaxf(v[k], 0.0f), 1.0f) * 255.0f);
+      ix += run;
     }
   }
 }
 
-// Update error image (blue = under, red = over)
-static inline void ui_update_error_texture(Color *pixels, const ReconGrid *g, int img_w, int img_h) {
-  for (int iy = 0; iy < g->ny; iy++) {
-    for (int ix = 0; ix < g->nx; ix++) {
-      float err = g->values[iy * g->nx + ix] - g->ground_truth[iy * g->nx + ix];
-      float scaled = err * 400.0f;
-
-      unsigned char r, gc, b;
-      if (scaled > 0) {
-        r = (unsigned char)fminf(scaled, 255.0f);
-        gc = 0;
-        b = 0;
-      } else {
-        r = 0;
-        gc = 0;
-        b = (unsigned char)fminf(-scaled, 255.0f);
+// Update error image (blue = under, red = over), one texel per cell, packed
+// like ui_update_recon_texture
+static inline void ui_update_error_texture(Color *pixels, const ReconGrid *g, ReconRect r) {
+  int w = r.x1 - r.x0;
+  f32x4 zero = f32x4_set1(0.0f), s400 = f32x4_set1(400.0f), s255 = f32x4_set1(255.0f);
+  for (int iy = r.y0; iy < r.y1; iy++) {
+    Color *out = pixels + (iy - r.y0) * w;
+    for (int ix = r.x0; ix < r.x1;) {
+      int run = recon_grid_run(g, ix, r.x1);
+      int i = recon_grid_index(g, ix, iy);
+      const float *v = g->values + i;
+      const float *t = g->ground_truth + i;
+      int k = 0;
+      for (; k + 4 <= run; k += 4) {
+        f32x4 scaled = f32x4_mul(f32x4_sub(f32x4_load(v + k), f32x4_load(t + k)), s400);
+        float red[4], blue[4];
+        f32x4_store(red, f32x4_min(f32x4_max(scaled, zero), s255));
+        f32x4_store(blue, f32x4_min(f32x4_max(f32x4_sub(zero, scaled), zero), s255));
+        for (int j = 0; j < 4; j++)
+          out[ix - r.x0 + k + j] = (Color){(unsigned char)red[j], 0, (unsigned char)blue[j], 255};
       }
-
-      for (int yy = 0; yy < g->cell_size; yy++) {
-        for (int xx = 0; xx < g->cell_size; xx++) {
-          int px = ix * g->cell_size + xx;
-          int py = iy * g->cell_size + yy;
-          if (px < img_w && py < img_h)
-            pixels[py * img_w + px] = (Color){r, gc, b, 255};
-        }
+      for (; k < run; k++) {
+        float scaled = (v[k] - t[k]) * 400.0f;
+        unsigned char red = scaled > 0 ? (unsigned char)fminf(scaled, 255.0f) : 0;
+        unsigned char blue = scaled > 0 ? 0 : (unsigned char)fminf(-scaled, 255.0f);
+        out[ix - r.x0 + k] = (Color){red, 0, blue, 255};
       }
+      ix += run;
     }
   }
 }